@@ -0,0 +1,143 @@
+#include <string.h>
+#include "agents.h"
+#include "bot.h"
+
+struct random_state {
+    uint64_t random;
+    struct presses held;
+};
+
+void randomStart(void *state, uint64_t seed, const char *options) {
+    struct random_state *random = state;
+    random->random = (seed ^ 0x9E3779B97F4A7C15ULL) * 0xBF58476D1CE4E5B9ULL;
+    if (random->random == 0) {
+        random->random = 1;
+    }
+}
+
+//presses a random key now and then, holding left or right for a while to use DAS
+struct inputs randomAct(void *state, struct game_data *data) {
+    struct random_state *random = state;
+    struct inputs inputs = {random->held, {0}};
+    switch (nextRandom(&random->random) % 32) {
+        case 0:
+            inputs.pressed.left = !random->held.left;
+            inputs.just_pressed.left = inputs.pressed.left;
+            break;
+        case 1:
+            inputs.pressed.right = !random->held.right;
+            inputs.just_pressed.right = inputs.pressed.right;
+            break;
+        case 2:
+            inputs.just_pressed.rotc = true;
+            break;
+        case 3:
+            inputs.just_pressed.rota = true;
+            break;
+        case 4:
+            inputs.just_pressed.rot180 = true;
+            break;
+        case 5:
+            inputs.just_pressed.hold = true;
+            break;
+        case 6:
+            inputs.just_pressed.hdrop = true;
+            break;
+        case 7:
+            inputs.pressed.sdrop = !random->held.sdrop;
+            inputs.just_pressed.sdrop = inputs.pressed.sdrop;
+            break;
+    }
+    random->held = inputs.pressed;
+    return inputs;
+}
+
+struct script_state {
+    const char *script;
+    int position;
+};
+
+void scriptStart(void *state, uint64_t seed, const char *options) {
+    struct script_state *script = state;
+    script->script = options != NULL && options[0] != '\0' ? options : "d";
+}
+
+//one character per step, looping back to the start at the end
+//l r c a f h d are taps of left, right, clockwise, anticlockwise, 180, hold and hard drop
+//L R S hold left, right or soft drop down for the step and anything else does nothing
+struct inputs scriptAct(void *state, struct game_data *data) {
+    struct script_state *script = state;
+    struct inputs inputs = {{0}, {0}};
+    switch (script->script[script->position]) {
+        case 'l':
+            inputs.just_pressed.left = true;
+            break;
+        case 'r':
+            inputs.just_pressed.right = true;
+            break;
+        case 'c':
+            inputs.just_pressed.rotc = true;
+            break;
+        case 'a':
+            inputs.just_pressed.rota = true;
+            break;
+        case 'f':
+            inputs.just_pressed.rot180 = true;
+            break;
+        case 'h':
+            inputs.just_pressed.hold = true;
+            break;
+        case 'd':
+            inputs.just_pressed.hdrop = true;
+            break;
+        case 'L':
+            inputs.pressed.left = true;
+            break;
+        case 'R':
+            inputs.pressed.right = true;
+            break;
+        case 'S':
+            inputs.pressed.sdrop = true;
+            break;
+    }
+    script->position = script->position + 1;
+    if (script->script[script->position] == '\0') {
+        script->position = 0;
+    }
+    return inputs;
+}
+
+void botStart(void *state, uint64_t seed, const char *options) {
+    struct bot_options bot_options = default_bot_options;
+    parseBotOptions(options, &bot_options);
+    initBot(state, bot_options);
+}
+
+//plays a whole piece at once whenever the next one is due and otherwise lets gravity run
+struct inputs botAct(void *state, struct game_data *data) {
+    botTurn(state, data);
+    return (struct inputs) {{0}, {0}};
+}
+
+void botFinish(void *state, struct agent_stats *stats) {
+    struct bot *bot = state;
+    stats->nodes = bot->stats.nodes;
+    stats->hits = bot->stats.hits;
+    freeBot(bot);
+}
+
+const struct agent random_agent = {"random", "mashes keys at random", true, sizeof(struct random_state), randomStart, randomAct, NULL};
+const struct agent script_agent = {"script", "loops the keys given in its options, see agents.c", true, sizeof(struct script_state), scriptStart, scriptAct, NULL};
+const struct agent bot_agent = {"bot", "beam search bot, options like width=64,depth=6,time=0.05,threads=1,pps=0,tt=16", false, sizeof(struct bot), botStart, botAct, botFinish};
+
+const struct agent *agents[] = {&random_agent, &script_agent, &bot_agent, NULL};
+
+const struct agent *findAgent(const char *name) {
+    int i;
+    for (i = 0; agents[i] != NULL; i++) {
+        if (strcmp(agents[i]->name, name) == 0) {
+            return agents[i];
+        }
+    }
+    return NULL;
+}
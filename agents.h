@@ -0,0 +1,38 @@
+#ifndef AGENTS_H
+#define AGENTS_H
+
+#include <stddef.h>
+#include "engine.h"
+
+//what an agent that searches reports at the end of a game
+struct agent_stats {
+    //boards searched
+    long nodes;
+    //boards found in a transposition table instead of being evaluated again
+    long hits;
+};
+
+//something that plays a game by deciding the inputs for every step
+struct agent {
+    const char *name;
+    const char *description;
+    //whether the agent only plays through its inputs, so its games can be recorded and replayed
+    bool replayable;
+    //bytes of state the agent needs per game, handed to start and act
+    size_t state_size;
+    //called when a game starts with zeroed state. options is whatever the user passed, or NULL
+    void (*start)(void *state, uint64_t seed, const char *options);
+    //returns the inputs for the next step of the game. agents that work out whole placements may also play them here
+    //but then they aren't replayable
+    struct inputs (*act)(void *state, struct game_data *data);
+    //called when the game ends to free anything start allocated and fill in stats
+    //can be NULL for agents that allocate and search nothing
+    void (*finish)(void *state, struct agent_stats *stats);
+};
+
+//NULL terminated list of every agent
+extern const struct agent *agents[];
+
+const struct agent *findAgent(const char *name);
+
+#endif
@@ -0,0 +1,31 @@
+#include <stdlib.h>
+#include "arena.h"
+
+bool initArena(struct arena *arena, size_t size) {
+    arena->base = malloc(size);
+    arena->size = arena->base != NULL ? size : 0;
+    arena->used = 0;
+    arena->peak = 0;
+    return arena->base != NULL;
+}
+
+void freeArena(struct arena *arena) {
+    free(arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+void *arenaAlloc(struct arena *arena, size_t size) {
+    size_t start = (arena->used + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    if (start > arena->size || size > arena->size - start) {
+        return NULL;
+    }
+    arena->used = start + size;
+    arena->peak = arena->used > arena->peak ? arena->used : arena->peak;
+    return arena->base + start;
+}
+
+void resetArena(struct arena *arena) {
+    arena->used = 0;
+}
@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+//a block of memory handed out by moving an offset along, all given back at once by resetArena
+//the game resets one at the top of every frame for scratch memory, so frames never have to touch the heap
+
+#define ARENA_ALIGN 16
+
+struct arena {
+    char *base;
+    size_t size;
+    size_t used;
+    //most that was used between two resets
+    size_t peak;
+};
+
+//allocates size bytes up front, returns false if they can't be had
+bool initArena(struct arena *arena, size_t size);
+void freeArena(struct arena *arena);
+//size bytes aligned to ARENA_ALIGN, or NULL if the arena is full
+void *arenaAlloc(struct arena *arena, size_t size);
+void resetArena(struct arena *arena);
+
+#endif
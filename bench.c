@@ -0,0 +1,346 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "engine.h"
+#include "movegen.h"
+#include "eval.h"
+#include "bot.h"
+
+//times the hot paths of the game logic on fixed boards so runs can be compared from one commit to the next
+
+//linked with -Wl,--wrap so every allocation made by the code being timed goes through here and gets counted
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+long allocations = 0;
+
+void *__wrap_malloc(size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    return __real_realloc(pointer, size);
+}
+
+#define PROBES 256
+
+enum fixtures {
+    FIXTURE_EMPTY,
+    //8 rows of garbage with a hole or two in each
+    FIXTURE_MID,
+    //14 rows of garbage, high enough to crowd the pieces but with room for gameStep to play a few before it tops out
+    FIXTURE_HIGH,
+    FIXTURES
+};
+
+const char *fixture_names[FIXTURES] = {"empty", "mid", "high"};
+
+//everything a case works on, set up the same way every run
+struct bench {
+    struct game_data data;
+    //pieces at the spawn height and pieces resting on the stack, spread over every type, rotation and column
+    struct tetromino spawned[PROBES];
+    struct tetromino resting[PROBES];
+    struct bot bot;
+    //keeps the results of each case alive so the compiler can't throw the work away
+    long sink;
+};
+
+struct bench_case {
+    const char *name;
+    //runs the case iterations times
+    void (*run)(struct bench *bench, long iterations);
+};
+
+//a deterministic board for each fixture, so every run and every commit times the same thing
+void makeFixture(struct bench *bench, enum fixtures fixture) {
+    initGame(&bench->data, 12345);
+    int heights[FIXTURES] = {0, 8, 14};
+    uint64_t random = 0x2545F4914F6CDD1DULL;
+    int y;
+    for (y = 0; y < heights[fixture]; y++) {
+        uint16_t row = FULL_ROW;
+        row &= ~(1 << (WALL_OFFSET + nextRandom(&random) % BOARD_WIDTH));
+        if (nextRandom(&random) % 3 == 0) {
+            row &= ~(1 << (WALL_OFFSET + nextRandom(&random) % BOARD_WIDTH));
+        }
+        bench->data.matrix.rows[y] = row;
+    }
+    updateHeights(&bench->data.matrix);
+    bench->data.hash = gameHash(&bench->data);
+
+    int i;
+    for (i = 0; i < PROBES; i++) {
+        struct tetromino piece = spawnPiece(i % 7);
+        piece.rotation = i / 7 % 4;
+        //start clear of the stack so every probe has somewhere to be
+        piece.y = piece.y > heights[fixture] + 3 ? piece.y : heights[fixture] + 3;
+        do {
+            piece.x = -1 + nextRandom(&random) % (BOARD_WIDTH + 1);
+        } while (collides(&bench->data.matrix, piece.type, piece.rotation, piece.x, piece.y));
+        bench->spawned[i] = piece;
+        piece.y = piece.y - getDroppedPos(&bench->data.matrix, piece);
+        bench->resting[i] = piece;
+    }
+}
+
+void benchCollides(struct bench *bench, long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++) {
+        struct tetromino piece = bench->resting[i % PROBES];
+        bench->sink += collides(&bench->data.matrix, piece.type, piece.rotation, piece.x + (i & 1), piece.y - (i >> 1 & 1));
+    }
+}
+
+void benchDroppedPos(struct bench *bench, long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++) {
+        bench->sink += getDroppedPos(&bench->data.matrix, bench->spawned[i % PROBES]);
+    }
+}
+
+void benchDASsedPos(struct bench *bench, long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++) {
+        bench->sink += getDASsedPos(&bench->data.matrix, bench->spawned[i % PROBES], i & 1 ? 1 : -1);
+    }
+}
+
+void benchRotatePiece(struct bench *bench, long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++) {
+        struct tetromino piece = bench->resting[i % PROBES];
+        bench->sink += rotatePiece(&bench->data.matrix, &piece, 1 + i % 3) + piece.x;
+    }
+}
+
+//clears 4 full rows laid on top of the fixture, which includes copying the board back each time
+void benchClearLines(struct bench *bench, long iterations) {
+    struct board board = bench->data.matrix;
+    int bottom = 0;
+    while (board.rows[bottom] != EMPTY_ROW) {
+        bottom = bottom + 1;
+    }
+    int y;
+    for (y = bottom; y < bottom + 4; y++) {
+        board.rows[y] = FULL_ROW;
+    }
+    struct board cleared;
+    int rows[4];
+    long i;
+    for (i = 0; i < iterations; i++) {
+        cleared = board;
+        bench->sink += clearLines(&cleared, bottom, bottom + 3, rows);
+    }
+}
+
+//takes the next piece from the queue, topping up the bag when it runs low
+void benchNewCurrent(struct bench *bench, long iterations) {
+    struct game_data data = bench->data;
+    long i;
+    for (i = 0; i < iterations; i++) {
+        bench->sink += newCurrent(&data);
+    }
+}
+
+//one 60th of a second of play with the same inputs a person might give, starting again from the fixture on a top out
+void benchGameStep(struct bench *bench, long iterations) {
+    struct game_data data = bench->data;
+    const char *script = "..L..cd..RR.a.S.d..f.hd";
+    long i;
+    for (i = 0; i < iterations; i++) {
+        struct inputs inputs = {{0}, {0}};
+        switch (script[i % 23]) {
+            case 'L':
+                inputs.pressed.left = true;
+                break;
+            case 'R':
+                inputs.pressed.right = true;
+                break;
+            case 'S':
+                inputs.pressed.sdrop = true;
+                break;
+            case 'c':
+                inputs.just_pressed.rotc = true;
+                break;
+            case 'a':
+                inputs.just_pressed.rota = true;
+                break;
+            case 'f':
+                inputs.just_pressed.rot180 = true;
+                break;
+            case 'h':
+                inputs.just_pressed.hold = true;
+                break;
+            case 'd':
+                inputs.just_pressed.hdrop = true;
+                break;
+        }
+        if (!gameStep(&data, inputs, 1 / 60.0)) {
+            data = bench->data;
+        }
+    }
+    bench->sink += data.score;
+}
+
+void benchFindPlacements(struct bench *bench, long iterations) {
+    struct placement placements[MAX_PLACEMENTS];
+    long i;
+    for (i = 0; i < iterations; i++) {
+        bench->sink += findPlacements(bench->data.matrix.rows, spawnPiece(i % 7), placements, MAX_PLACEMENTS);
+    }
+}
+
+//one board per op, scored in batches of 64 like the bot does
+void benchBatchFeatures(struct bench *bench, long iterations) {
+    const uint16_t *boards[64];
+    struct eval_features features[64];
+    int i;
+    for (i = 0; i < 64; i++) {
+        boards[i] = bench->data.matrix.rows;
+    }
+    long done;
+    for (done = 0; done < iterations; done = done + 64) {
+        int count = iterations - done < 64 ? iterations - done : 64;
+        batchFeatures(boards, count, features);
+        bench->sink += features[0].holes;
+    }
+}
+
+//a whole search for one piece with the default options on one thread
+void benchBotThink(struct bench *bench, long iterations) {
+    struct bot_move move;
+    long i;
+    for (i = 0; i < iterations; i++) {
+        //start each search from a cold table so every op does the same work
+        clearTable(&bench->bot.table);
+        bench->sink += botThink(&bench->bot, &bench->data, &move);
+    }
+}
+
+const struct bench_case cases[] = {
+    {"collides", benchCollides},
+    {"getDroppedPos", benchDroppedPos},
+    {"getDASsedPos", benchDASsedPos},
+    {"rotatePiece", benchRotatePiece},
+    {"clearLines", benchClearLines},
+    {"newCurrent", benchNewCurrent},
+    {"gameStep", benchGameStep},
+    {"findPlacements", benchFindPlacements},
+    {"batchFeatures", benchBatchFeatures},
+    {"botThink", benchBotThink},
+};
+
+double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+void usage(const char *name) {
+    fprintf(stderr, "usage: %s [options]\n"
+                    "  -f filter      only run cases whose name contains filter\n"
+                    "  -m seconds     time each run of a case for at least this long (0.1)\n"
+                    "  -r runs        runs of each case, the fastest is reported (5)\n"
+                    "  -j             print one JSON object per case instead of a table\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    const char *filter = "";
+    double min_time = 0.1;
+    int runs = 5;
+    bool json = false;
+    int option;
+    while ((option = getopt(argc, argv, "f:m:r:jh")) != -1) {
+        switch (option) {
+            case 'f':
+                filter = optarg;
+                break;
+            case 'm':
+                min_time = atof(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            case 'j':
+                json = true;
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    struct bench *bench = malloc(sizeof(struct bench));
+    bench->sink = 0;
+    struct bot_options options = default_bot_options;
+    options.think_time = 1e9;
+    initBot(&bench->bot, options);
+
+    if (!json) {
+        printf("%-16s %-8s %14s %12s %14s\n", "case", "fixture", "ns/op", "allocs/op", "ops");
+    }
+    int i, fixture, run;
+    for (i = 0; i < (int) (sizeof(cases) / sizeof(cases[0])); i++) {
+        if (strstr(cases[i].name, filter) == NULL) {
+            continue;
+        }
+        for (fixture = 0; fixture < FIXTURES; fixture++) {
+            makeFixture(bench, fixture);
+            //the queue doesn't depend on the board, so once is enough
+            if (cases[i].run == benchNewCurrent && fixture != FIXTURE_EMPTY) {
+                continue;
+            }
+
+            //double the iterations until a run takes long enough to time well
+            long iterations = 1;
+            double elapsed = 0;
+            while (elapsed < min_time) {
+                iterations = iterations * 2;
+                double start = now();
+                cases[i].run(bench, iterations);
+                elapsed = now() - start;
+            }
+            double best = elapsed;
+            long allocated = 0;
+            for (run = 0; run < runs; run++) {
+                long before = allocations;
+                double start = now();
+                cases[i].run(bench, iterations);
+                elapsed = now() - start;
+                allocated = allocations - before;
+                best = elapsed < best ? elapsed : best;
+            }
+
+            double ns = best * 1e9 / iterations;
+            double allocs = (double) allocated / iterations;
+            if (json) {
+                printf("{\"case\":\"%s\",\"fixture\":\"%s\",\"ns_per_op\":%.3f,\"allocs_per_op\":%.4f,\"ops\":%ld,\"runs\":%d}\n",
+                       cases[i].name, fixture_names[fixture], ns, allocs, iterations, runs);
+            } else {
+                printf("%-16s %-8s %14.2f %12.4f %14ld\n", cases[i].name, fixture_names[fixture], ns, allocs, iterations);
+            }
+            fflush(stdout);
+        }
+    }
+
+    freeBot(&bench->bot);
+    //print the sink where nobody will look so the work can't be optimised out
+    fprintf(stderr, "%s", bench->sink == 42 ? " " : "");
+    free(bench);
+    return 0;
+}
@@ -0,0 +1,453 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bot.h"
+#include "pool.h"
+
+//a board the search has reached, and what it will have to place next
+struct node {
+    uint16_t rows[BOARD_HEIGHT];
+    uint64_t board_hash;
+    //hash of the board and everything in stateHash, the same as game_data's hash for the same position
+    uint64_t hash;
+    //piece to place next, -1 once the search has run past the previews
+    int8_t current;
+    //held piece, -1 when nothing is held
+    int8_t hold;
+    //index into the queue of the piece after current
+    int8_t next;
+    bool can_hold;
+    //line clear rewards along the way, and that plus how good the board looks
+    int reward;
+    int value;
+    //the move at the root that this board came from
+    struct bot_move first;
+};
+
+//everything a search thread needs to expand one node
+struct search {
+    struct bot *bot;
+    //the current piece then the previews
+    int8_t queue[BOT_MAX_DEPTH];
+    int known;
+    //queue position of the root, so node hashes match the game's
+    int drawn;
+    //where the current piece actually is, the root searches from there instead of the spawn
+    struct tetromino root_piece;
+    bool root;
+};
+
+const struct bot_options default_bot_options = {64, BOT_MAX_DEPTH, 0.05, 1, 0, 16, &default_weights};
+
+double botClock(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+void initBot(struct bot *bot, struct bot_options options) {
+    if (options.threads < 1) {
+        options.threads = 1;
+    }
+    if (options.depth < 1 || options.depth > BOT_MAX_DEPTH) {
+        options.depth = BOT_MAX_DEPTH;
+    }
+    if (options.beam_width < 1) {
+        options.beam_width = 1;
+    }
+    bot->options = options;
+    bot->stats = (struct bot_stats) {0, 0, 0, 0, 0};
+    bot->beam = malloc(sizeof(struct node) * options.beam_width);
+    bot->beam_count = 0;
+    bot->children = calloc(options.threads, sizeof(struct node *));
+    bot->children_count = calloc(options.threads, sizeof(int));
+    bot->children_size = calloc(options.threads, sizeof(int));
+    bot->hits = calloc(options.threads, sizeof(long));
+    //each node has its placements and the same again from holding
+    int i;
+    for (i = 0; i < options.threads; i++) {
+        bot->children_size[i] = options.beam_width * 2 * BOT_PLACEMENTS;
+        bot->children[i] = malloc(sizeof(struct node) * bot->children_size[i]);
+    }
+    initTable(&bot->table, options.table_bits);
+    bot->searches = 0;
+    bot->ranked_size = options.threads * options.beam_width * 2 * BOT_PLACEMENTS;
+    bot->ranked = malloc(sizeof(struct node *) * bot->ranked_size);
+    bot->next_piece = 0;
+}
+
+void freeBot(struct bot *bot) {
+    int i;
+    for (i = 0; i < bot->options.threads; i++) {
+        free(bot->children[i]);
+    }
+    free(bot->children);
+    free(bot->children_count);
+    free(bot->children_size);
+    free(bot->hits);
+    freeTable(&bot->table);
+    free(bot->beam);
+    free(bot->ranked);
+}
+
+void parseBotOptions(const char *text, struct bot_options *options) {
+    char name[16];
+    double value;
+    int length;
+    while (text != NULL && sscanf(text, " %15[^=]=%lf%n", name, &value, &length) == 2) {
+        if (strcmp(name, "width") == 0) {
+            options->beam_width = value;
+        } else if (strcmp(name, "depth") == 0) {
+            options->depth = value;
+        } else if (strcmp(name, "time") == 0) {
+            options->think_time = value;
+        } else if (strcmp(name, "threads") == 0) {
+            options->threads = value;
+        } else if (strcmp(name, "pps") == 0) {
+            options->pps = value;
+        } else if (strcmp(name, "tt") == 0) {
+            options->table_bits = value;
+        }
+        text = text + length;
+        if (*text != ',') {
+            break;
+        }
+        text = text + 1;
+    }
+}
+
+//locks a piece into a bare set of rows and clears any lines, returning how many. hash is kept up to date like lockPiece does
+int lockRows(uint16_t rows[BOARD_HEIGHT], uint64_t *hash, int type, struct placement placement) {
+    const struct piece_shape *shape = &SHAPES[type][placement.rotation];
+    int cleared = 0;
+    int full = BOARD_HEIGHT;
+    int i;
+    for (i = 0; i < 4; i++) {
+        if (shape->rows[i]) {
+            uint32_t placed = placeRow(shape->rows[i], placement.x);
+            *hash ^= rowHash(placement.y - i, placed);
+            rows[placement.y - i] |= placed;
+            full = rows[placement.y - i] == FULL_ROW ? placement.y - i : full;
+        }
+    }
+    if (full == BOARD_HEIGHT) {
+        return 0;
+    }
+    *hash ^= stackHash(rows, full);
+    //go from the top of the piece down so removing a row doesn't move the ones still to check
+    for (i = 0; i < 4; i++) {
+        int y = placement.y - i;
+        if (shape->rows[i] && rows[y] == FULL_ROW) {
+            memmove(&rows[y], &rows[y + 1], sizeof(uint16_t) * (BOARD_HEIGHT - 1 - y));
+            rows[BOARD_HEIGHT - 1] = EMPTY_ROW;
+            cleared = cleared + 1;
+        }
+    }
+    *hash ^= stackHash(rows, full);
+    return cleared;
+}
+
+//there's always room, since no node has more than 2 * BOT_PLACEMENTS children
+struct node *newChild(struct bot *bot, int worker) {
+    bot->children_count[worker] = bot->children_count[worker] + 1;
+    return &bot->children[worker][bot->children_count[worker] - 1];
+}
+
+//adds a child for every place piece can go from parent, with hold and current being what they are afterwards
+void placeChildren(struct search *search, int worker, struct node *parent, struct tetromino piece, int hold, int next, bool held) {
+    struct bot *bot = search->bot;
+    struct placement placements[MAX_PLACEMENTS];
+    int count = findPlacements(parent->rows, piece, placements, BOT_PLACEMENTS);
+    int first = bot->children_count[worker];
+    long hits = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        //locking entirely above the visible board loses the game
+        if (placements[i].y - SHAPES[piece.type][placements[i].rotation].cells[3].y >= 20) {
+            continue;
+        }
+        struct node *child = newChild(bot, worker);
+        memcpy(child->rows, parent->rows, sizeof(child->rows));
+        child->board_hash = parent->board_hash;
+        int lines = lockRows(child->rows, &child->board_hash, piece.type, placements[i]);
+        child->hold = hold;
+        child->current = next < search->known ? search->queue[next] : -1;
+        child->next = next + 1;
+        child->can_hold = true;
+        child->hash = child->board_hash ^ stateHash(child->current, hold, search->drawn + next, false);
+        child->reward = parent->reward + bot->options.weights->clears[lines];
+        child->first = search->root ? (struct bot_move) {held, placements[i]} : parent->first;
+    }
+
+    //look every new board up in the table and score the rest all at once so the evaluation kernel can do a batch
+    //of them side by side
+    struct node *children = &bot->children[worker][first];
+    int added = bot->children_count[worker] - first;
+    const uint16_t *boards[MAX_PLACEMENTS];
+    int missed[MAX_PLACEMENTS];
+    struct eval_features features[MAX_PLACEMENTS];
+    int misses = 0;
+    uint64_t data;
+    for (i = 0; i < added; i++) {
+        if (ttProbe(&bot->table, children[i].hash, &data)) {
+            children[i].value = children[i].reward + (int32_t) data;
+            hits = hits + 1;
+        } else {
+            boards[misses] = children[i].rows;
+            missed[misses] = i;
+            misses = misses + 1;
+        }
+    }
+    batchFeatures(boards, misses, features);
+    for (i = 0; i < misses; i++) {
+        int value = evaluateFeatures(&features[i], bot->options.weights);
+        children[missed[i]].value = children[missed[i]].reward + value;
+        ttStore(&bot->table, children[missed[i]].hash, (uint32_t) value);
+    }
+    bot->hits[worker] = bot->hits[worker] + hits;
+}
+
+void expandNode(void *context, int index, int worker) {
+    struct search *search = context;
+    struct node *node = &search->bot->beam[index];
+    if (node->current < 0) {
+        return;
+    }
+    struct tetromino piece = search->root ? search->root_piece : spawnPiece(node->current);
+    placeChildren(search, worker, node, piece, node->hold, node->next, false);
+
+    if (!node->can_hold) {
+        return;
+    }
+    if (node->hold >= 0) {
+        placeChildren(search, worker, node, spawnPiece(node->hold), node->current, node->next, true);
+    } else if (node->next < search->known) {
+        placeChildren(search, worker, node, spawnPiece(search->queue[node->next]), node->current, node->next + 1, true);
+    }
+}
+
+//best first, with ties broken on the move and board so the result doesn't depend on how the threads split the work
+int compareNodes(const void *a, const void *b) {
+    const struct node *x = *(struct node * const *) a;
+    const struct node *y = *(struct node * const *) b;
+    if (x->value != y->value) {
+        return y->value - x->value;
+    }
+    if (x->first.hold != y->first.hold) {
+        return x->first.hold - y->first.hold;
+    }
+    int difference = memcmp(&x->first.placement, &y->first.placement, sizeof(struct placement));
+    if (difference != 0) {
+        return difference;
+    }
+    return memcmp(x->rows, y->rows, sizeof(x->rows));
+}
+
+bool botThink(struct bot *bot, struct game_data *data, struct bot_move *move) {
+    double start = botClock();
+    struct search search;
+    search.bot = bot;
+    search.root_piece = data->current;
+    search.known = BOT_MAX_DEPTH;
+    //the piece at queue index i becomes current once drawn + i pieces have been taken from the queue
+    search.drawn = data->drawn;
+    search.queue[0] = data->current.type;
+    int i;
+    for (i = 1; i < search.known; i++) {
+        search.queue[i] = upcomingPiece(data, i - 1);
+    }
+
+    struct node *root = &bot->beam[0];
+    memcpy(root->rows, data->matrix.rows, sizeof(root->rows));
+    root->current = data->current.type;
+    root->hold = data->holding ? data->hold_piece.type : -1;
+    root->next = 1;
+    root->can_hold = !data->has_been_held;
+    root->reward = 0;
+    root->value = 0;
+    root->hash = data->hash;
+    root->board_hash = data->hash ^ stateHash(root->current, root->hold, data->drawn, data->has_been_held);
+    bot->beam_count = 1;
+    bot->searches = bot->searches + 1;
+
+    bool found = false;
+    int depth;
+    for (depth = 0; depth < bot->options.depth; depth++) {
+        search.root = depth == 0;
+        for (i = 0; i < bot->options.threads; i++) {
+            bot->children_count[i] = 0;
+            bot->hits[i] = 0;
+        }
+        poolRun(bot->options.threads, bot->beam_count, expandNode, &search);
+
+        int total = 0;
+        for (i = 0; i < bot->options.threads; i++) {
+            total = total + bot->children_count[i];
+            bot->stats.hits = bot->stats.hits + bot->hits[i];
+        }
+        bot->stats.nodes = bot->stats.nodes + total;
+        //every board ran out of room, so go with the best of the depth before
+        if (total == 0) {
+            break;
+        }
+
+        int count = 0;
+        int j;
+        for (i = 0; i < bot->options.threads; i++) {
+            for (j = 0; j < bot->children_count[i]; j++) {
+                bot->ranked[count] = &bot->children[i][j];
+                count = count + 1;
+            }
+        }
+        qsort(bot->ranked, total, sizeof(struct node *), compareNodes);
+
+        //take the best boards, skipping any position already taken through another order of moves
+        //marking the taken ones in the table happens here on one thread so the result doesn't depend on timing
+        uint64_t mark = (uint64_t) (bot->searches * BOT_MAX_DEPTH + depth + 1) << 32;
+        uint64_t stored;
+        bot->beam_count = 0;
+        for (i = 0; i < total && bot->beam_count < bot->options.beam_width; i++) {
+            struct node *node = bot->ranked[i];
+            if (ttProbe(&bot->table, node->hash, &stored) && (stored & ~(uint64_t) UINT32_MAX) == mark) {
+                bot->stats.duplicates = bot->stats.duplicates + 1;
+                continue;
+            }
+            ttStore(&bot->table, node->hash, mark | (uint32_t) (node->value - node->reward));
+            bot->beam[bot->beam_count] = *node;
+            bot->beam_count = bot->beam_count + 1;
+        }
+        *move = bot->beam[0].first;
+        found = true;
+
+        if (botClock() - start > bot->options.think_time) {
+            break;
+        }
+    }
+
+    bot->stats.pieces = bot->stats.pieces + 1;
+    bot->stats.thinking = bot->stats.thinking + botClock() - start;
+    return found;
+}
+
+bool botPlay(struct game_data *data, struct bot_move move) {
+    if (move.hold && !holdPiece(data)) {
+        return false;
+    }
+    return placePiece(data, move.placement.rotation, move.placement.x, move.placement.y);
+}
+
+void botTurn(struct bot *bot, struct game_data *data) {
+    if (data->time < bot->next_piece) {
+        return;
+    }
+    bot->next_piece = bot->options.pps > 0 ? data->time + 1 / bot->options.pps : 0;
+    struct bot_move move;
+    if (botThink(bot, data, &move)) {
+        botPlay(data, move);
+    }
+}
+
+void *runSearches(void *context) {
+    struct bot_runner *runner = context;
+    pthread_mutex_lock(&runner->lock);
+    while (true) {
+        while (!runner->wanted && !runner->quit) {
+            pthread_cond_wait(&runner->wake, &runner->lock);
+        }
+        if (runner->quit) {
+            break;
+        }
+        runner->wanted = false;
+        pthread_mutex_unlock(&runner->lock);
+        bool found = botThink(runner->bot, &runner->data, &runner->move);
+        pthread_mutex_lock(&runner->lock);
+        runner->found = found;
+        runner->done = true;
+    }
+    pthread_mutex_unlock(&runner->lock);
+    return NULL;
+}
+
+void initRunner(struct bot_runner *runner, struct bot *bot) {
+    runner->bot = bot;
+    runner->wanted = false;
+    runner->done = false;
+    runner->quit = false;
+    runner->searching = false;
+    pthread_mutex_init(&runner->lock, NULL);
+    pthread_cond_init(&runner->wake, NULL);
+    runner->started = pthread_create(&runner->thread, NULL, runSearches, runner) == 0;
+}
+
+//whether the piece can still be put where the search meant it to go. gravity may have pulled it down past
+//an overhang or a kick it needed while the search ran, which at high levels or 20G happens often
+bool stillReachable(struct game_data *data, struct game_data *searched, struct bot_move move) {
+    if (move.hold || data->current.y == searched->current.y) {
+        return true;
+    }
+    struct placement placements[MAX_PLACEMENTS];
+    int count = findPlacements(data->matrix.rows, data->current, placements, MAX_PLACEMENTS);
+    int i;
+    for (i = 0; i < count; i++) {
+        if (placements[i].rotation == move.placement.rotation && placements[i].x == move.placement.x && placements[i].y == move.placement.y) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void botTurnInBackground(struct bot_runner *runner, struct game_data *data) {
+    if (runner->searching) {
+        pthread_mutex_lock(&runner->lock);
+        bool done = runner->done;
+        pthread_mutex_unlock(&runner->lock);
+        if (!done) {
+            return;
+        }
+        runner->searching = false;
+        //anything but gravity moving the piece means the move was for a game that's gone. a move that can't be
+        //reached any more is thrown away too, and the next call searches again from where the piece is now
+        if (runner->found && data->hash == runner->data.hash && data->drawn == runner->data.drawn && stillReachable(data, &runner->data, runner->move)) {
+            botPlay(data, runner->move);
+        }
+        else {
+            runner->bot->next_piece = data->time;
+        }
+        return;
+    }
+    if (data->time < runner->bot->next_piece) {
+        return;
+    }
+    runner->bot->next_piece = runner->bot->options.pps > 0 ? data->time + 1 / runner->bot->options.pps : 0;
+    if (!runner->started) {
+        //no thread to be had, so think here instead
+        struct bot_move move;
+        if (botThink(runner->bot, data, &move)) {
+            botPlay(data, move);
+        }
+        return;
+    }
+    //the thread is waiting, so nothing is reading data while it's written
+    runner->data = *data;
+    pthread_mutex_lock(&runner->lock);
+    runner->done = false;
+    runner->wanted = true;
+    pthread_cond_signal(&runner->wake);
+    pthread_mutex_unlock(&runner->lock);
+    runner->searching = true;
+}
+
+void stopRunner(struct bot_runner *runner) {
+    if (runner->started) {
+        pthread_mutex_lock(&runner->lock);
+        runner->quit = true;
+        pthread_cond_signal(&runner->wake);
+        pthread_mutex_unlock(&runner->lock);
+        pthread_join(runner->thread, NULL);
+        runner->started = false;
+    }
+    pthread_mutex_destroy(&runner->lock);
+    pthread_cond_destroy(&runner->wake);
+}
@@ -0,0 +1,110 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <pthread.h>
+#include "engine.h"
+#include "eval.h"
+#include "movegen.h"
+#include "tt.h"
+
+//the current piece plus the 5 previews that are shown
+#define BOT_MAX_DEPTH 6
+//most placements of one piece the search looks at. play rarely sees more than 90, and capping it means every
+//node's children fit in room set aside by initBot, so a search never allocates
+#define BOT_PLACEMENTS 128
+
+struct bot_options {
+    //how many boards are kept at each step of the search
+    int beam_width;
+    //how many pieces to look ahead, including the current one
+    int depth;
+    //seconds the bot may spend on one piece, it stops at the end of a depth once this runs out
+    double think_time;
+    int threads;
+    //pieces per second botTurn plays at, 0 to place one every time it's called
+    double pps;
+    //the transposition table has 2^table_bits entries, 0 turns it off
+    int table_bits;
+    const struct eval_weights *weights;
+};
+
+extern const struct bot_options default_bot_options;
+
+struct bot_move {
+    bool hold;
+    struct placement placement;
+};
+
+struct bot_stats {
+    long nodes;
+    //boards whose evaluation was found in the transposition table
+    long hits;
+    //boards left out of the beam because the same position was already in it
+    long duplicates;
+    long pieces;
+    double thinking;
+};
+
+struct node;
+
+struct bot {
+    struct bot_options options;
+    struct bot_stats stats;
+    struct node *beam;
+    int beam_count;
+    //children found by each thread, room for every child of the whole beam since any thread can end up expanding all of it
+    struct node **children;
+    int *children_count;
+    int *children_size;
+    struct node **ranked;
+    int ranked_size;
+    //evaluations of positions seen so far, kept from one piece to the next
+    struct table table;
+    //table hits found by each thread
+    long *hits;
+    //number of searches so far, which marks the positions put in the beam by each one
+    uint32_t searches;
+    //game time botTurn next places a piece at
+    double next_piece;
+};
+
+//runs the bot's searches on a thread of their own, so whoever is calling, like a frame being drawn, doesn't wait on them
+struct bot_runner {
+    struct bot *bot;
+    //started once by initRunner and woken for each search, false if it couldn't be started
+    pthread_t thread;
+    bool started;
+    //guards wanted, done and quit, with wake signalled when wanted or quit is set
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool wanted;
+    bool done;
+    bool quit;
+    //whether a search has been asked for and its move not yet taken, only looked at by the caller
+    bool searching;
+    //the game as it was when the search started, which the search reads from
+    struct game_data data;
+    struct bot_move move;
+    bool found;
+};
+
+void initBot(struct bot *bot, struct bot_options options);
+void freeBot(struct bot *bot);
+//reads options like "width=64,depth=6,time=0.01,threads=1,pps=2,tt=16" over the top of options
+void parseBotOptions(const char *text, struct bot_options *options);
+//searches the current piece, previews and hold for the best move. returns false if the piece can't go anywhere
+bool botThink(struct bot *bot, struct game_data *data, struct bot_move *move);
+//carries out a move from botThink
+bool botPlay(struct game_data *data, struct bot_move move);
+//thinks and plays once the next piece is due at the bot's pace, leaving the game to gravity otherwise
+void botTurn(struct bot *bot, struct game_data *data);
+
+//starts the runner's thread, which waits for searches until stopRunner
+void initRunner(struct bot_runner *runner, struct bot *bot);
+//like botTurn, but the search runs in the background and its move is played by the first call after it's done,
+//as long as the game is still on the piece it was searching for and the piece can still get there
+void botTurnInBackground(struct bot_runner *runner, struct game_data *data);
+//waits for a search that's still running and ends the thread, which has to happen before the bot is freed
+void stopRunner(struct bot_runner *runner);
+
+#endif
@@ -0,0 +1,927 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "engine.h"
+#include "trace.h"
+
+const char names[7] = {'I', 'T', 'Z', 'S', 'L', 'J', 'O'};
+
+const struct settings default_settings = {DAS, ARR, LOCK_DELAY, SDROP_GRAVITY, GRAVITY_BASE, GRAVITY_STEP, {100, 300, 500, 800}, false};
+
+//every piece in all 4 orientations, rotated clockwise about the SRS centres
+const struct piece_shape SHAPES[7][4] = {
+    //I
+    {
+        {{0x0, 0xF, 0x0, 0x0}, {{0, 1}, {1, 1}, {2, 1}, {3, 1}}, {1, 1, 1, 1}},
+        {{0x4, 0x4, 0x4, 0x4}, {{2, 0}, {2, 1}, {2, 2}, {2, 3}}, {-1, -1, 3, -1}},
+        {{0x0, 0x0, 0xF, 0x0}, {{0, 2}, {1, 2}, {2, 2}, {3, 2}}, {2, 2, 2, 2}},
+        {{0x2, 0x2, 0x2, 0x2}, {{1, 0}, {1, 1}, {1, 2}, {1, 3}}, {-1, 3, -1, -1}},
+    },
+    //T
+    {
+        {{0x2, 0x7, 0x0, 0x0}, {{1, 0}, {0, 1}, {1, 1}, {2, 1}}, {1, 1, 1, -1}},
+        {{0x2, 0x6, 0x2, 0x0}, {{1, 0}, {1, 1}, {2, 1}, {1, 2}}, {-1, 2, 1, -1}},
+        {{0x0, 0x7, 0x2, 0x0}, {{0, 1}, {1, 1}, {2, 1}, {1, 2}}, {1, 2, 1, -1}},
+        {{0x2, 0x3, 0x2, 0x0}, {{1, 0}, {0, 1}, {1, 1}, {1, 2}}, {1, 2, -1, -1}},
+    },
+    //Z
+    {
+        {{0x3, 0x6, 0x0, 0x0}, {{0, 0}, {1, 0}, {1, 1}, {2, 1}}, {0, 1, 1, -1}},
+        {{0x4, 0x6, 0x2, 0x0}, {{2, 0}, {1, 1}, {2, 1}, {1, 2}}, {-1, 2, 1, -1}},
+        {{0x0, 0x3, 0x6, 0x0}, {{0, 1}, {1, 1}, {1, 2}, {2, 2}}, {1, 2, 2, -1}},
+        {{0x2, 0x3, 0x1, 0x0}, {{1, 0}, {0, 1}, {1, 1}, {0, 2}}, {2, 1, -1, -1}},
+    },
+    //S
+    {
+        {{0x6, 0x3, 0x0, 0x0}, {{1, 0}, {2, 0}, {0, 1}, {1, 1}}, {1, 1, 0, -1}},
+        {{0x2, 0x6, 0x4, 0x0}, {{1, 0}, {1, 1}, {2, 1}, {2, 2}}, {-1, 1, 2, -1}},
+        {{0x0, 0x6, 0x3, 0x0}, {{1, 1}, {2, 1}, {0, 2}, {1, 2}}, {2, 2, 1, -1}},
+        {{0x1, 0x3, 0x2, 0x0}, {{0, 0}, {0, 1}, {1, 1}, {1, 2}}, {1, 2, -1, -1}},
+    },
+    //L
+    {
+        {{0x4, 0x7, 0x0, 0x0}, {{2, 0}, {0, 1}, {1, 1}, {2, 1}}, {1, 1, 1, -1}},
+        {{0x2, 0x2, 0x6, 0x0}, {{1, 0}, {1, 1}, {1, 2}, {2, 2}}, {-1, 2, 2, -1}},
+        {{0x0, 0x7, 0x1, 0x0}, {{0, 1}, {1, 1}, {2, 1}, {0, 2}}, {2, 1, 1, -1}},
+        {{0x3, 0x2, 0x2, 0x0}, {{0, 0}, {1, 0}, {1, 1}, {1, 2}}, {0, 2, -1, -1}},
+    },
+    //J
+    {
+        {{0x1, 0x7, 0x0, 0x0}, {{0, 0}, {0, 1}, {1, 1}, {2, 1}}, {1, 1, 1, -1}},
+        {{0x6, 0x2, 0x2, 0x0}, {{1, 0}, {2, 0}, {1, 1}, {1, 2}}, {-1, 2, 0, -1}},
+        {{0x0, 0x7, 0x4, 0x0}, {{0, 1}, {1, 1}, {2, 1}, {2, 2}}, {1, 1, 2, -1}},
+        {{0x2, 0x2, 0x3, 0x0}, {{1, 0}, {1, 1}, {0, 2}, {1, 2}}, {2, 2, -1, -1}},
+    },
+    //O
+    {
+        {{0x6, 0x6, 0x0, 0x0}, {{1, 0}, {2, 0}, {1, 1}, {2, 1}}, {-1, 1, 1, -1}},
+        {{0x6, 0x6, 0x0, 0x0}, {{1, 0}, {2, 0}, {1, 1}, {2, 1}}, {-1, 1, 1, -1}},
+        {{0x6, 0x6, 0x0, 0x0}, {{1, 0}, {2, 0}, {1, 1}, {2, 1}}, {-1, 1, 1, -1}},
+        {{0x6, 0x6, 0x0, 0x0}, {{1, 0}, {2, 0}, {1, 1}, {2, 1}}, {-1, 1, 1, -1}},
+    }
+};
+
+//positions tried in order when rotating, indexed by [I or not][rotation before][amount - 1]
+//y is upwards here, the same as on the board
+const struct offset KICKS[2][4][3][KICK_TESTS] = {
+    //J, L, S, T, Z
+    {
+        {{{0, 0}, {-1, 0}, {-1, 1}, {0, -2}, {-1, -2}}, {{0, 0}, {0, 1}, {1, 0}, {-1, 0}, {0, -1}}, {{0, 0}, {1, 0}, {1, 1}, {0, -2}, {1, -2}}},
+        {{{0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2}}, {{0, 0}, {1, 0}, {-1, 0}, {0, 1}, {0, -1}}, {{0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2}}},
+        {{{0, 0}, {1, 0}, {1, 1}, {0, -2}, {1, -2}}, {{0, 0}, {0, -1}, {-1, 0}, {1, 0}, {0, 1}}, {{0, 0}, {-1, 0}, {-1, 1}, {0, -2}, {-1, -2}}},
+        {{{0, 0}, {-1, 0}, {-1, -1}, {0, 2}, {-1, 2}}, {{0, 0}, {-1, 0}, {1, 0}, {0, 1}, {0, -1}}, {{0, 0}, {-1, 0}, {-1, -1}, {0, 2}, {-1, 2}}}
+    },
+    //I
+    {
+        {{{0, 0}, {-2, 0}, {1, 0}, {-2, -1}, {1, 2}}, {{0, 0}, {0, 1}, {1, 0}, {-1, 0}, {0, -1}}, {{0, 0}, {-1, 0}, {2, 0}, {-1, 2}, {2, -1}}},
+        {{{0, 0}, {-1, 0}, {2, 0}, {-1, 2}, {2, -1}}, {{0, 0}, {1, 0}, {-1, 0}, {0, 1}, {0, -1}}, {{0, 0}, {2, 0}, {-1, 0}, {2, 1}, {-1, -2}}},
+        {{{0, 0}, {2, 0}, {-1, 0}, {2, 1}, {-1, -2}}, {{0, 0}, {0, -1}, {-1, 0}, {1, 0}, {0, 1}}, {{0, 0}, {1, 0}, {-2, 0}, {1, -2}, {-2, 1}}},
+        {{{0, 0}, {1, 0}, {-2, 0}, {1, -2}, {-2, 1}}, {{0, 0}, {-1, 0}, {1, 0}, {0, 1}, {0, -1}}, {{0, 0}, {-2, 0}, {1, 0}, {-2, -1}, {1, 2}}}
+    }
+};
+
+//random keys for hashing positions, generated once with splitmix64 so every build hashes the same way
+const uint64_t ZOBRIST_CELLS[BOARD_HEIGHT][BOARD_WIDTH] = {
+    {
+        0x47596F7E3A7CA6F5ULL, 0x6B668A0DBBBF6F79ULL, 0x839134284D96505FULL, 0x692CF54B11D5ADDBULL,
+        0x8E67A492AC3A4B30ULL, 0xD495627A3D3E7C10ULL, 0x5C9A7CD80299158CULL, 0x867CD2A948F5CDF9ULL,
+        0x24969F096A7EEAA7ULL, 0xD7E4E58928072B5FULL,
+    },
+    {
+        0x52459DB6E68A9ECBULL, 0x8EFA03E0861E7649ULL, 0x36795A510A44DE52ULL, 0x31D9DEBE025C0243ULL,
+        0xD69F3D6505455211ULL, 0x314CE34C4E748B49ULL, 0xD1B4230B0C2FB9B7ULL, 0x3DDFEEAA834C4E14ULL,
+        0xEBB6449DF4613117ULL, 0x516FBD1EDA89F11BULL,
+    },
+    {
+        0x3FD1F907C19122B1ULL, 0x874B82A042DB811DULL, 0x02F689868C74E6E7ULL, 0xE8F95F5712E1EE38ULL,
+        0x1CA54450D7118330ULL, 0x16E0F304C4F6E261ULL, 0x94C708A9B7CCDCC9ULL, 0x86D74D21A5992269ULL,
+        0xE03D9076FF966EDAULL, 0x8061F77DFF3CFF62ULL,
+    },
+    {
+        0xD247E3B735588143ULL, 0x097F53244DCC27C9ULL, 0x680159B737EB3265ULL, 0xDED16D9E40119889ULL,
+        0x583D9097AF2D4854ULL, 0x55F6B699B7A4CFE3ULL, 0x204945DA70B73030ULL, 0x5242A306A1984085ULL,
+        0x4C90A606F5F8F4CBULL, 0xF61964E5D74F13A4ULL,
+    },
+    {
+        0xF318072CE14DF1ECULL, 0xCF0D7BDBEF4C1160ULL, 0xEE9EAA637733DD84ULL, 0x3F380D6C97413409ULL,
+        0xDECC5EE1FA524F60ULL, 0xD23391BFEDC94534ULL, 0xF0B5ED73213447B4ULL, 0x7784FA13F5B60F4FULL,
+        0xD595CBB6C5F4DAFEULL, 0x0DC4081CF2A3DF81ULL,
+    },
+    {
+        0x3467673B1127E8C4ULL, 0x1BCAC37778E89DF0ULL, 0xF596C86102CDCEE8ULL, 0x1BE5E06599CD8F1EULL,
+        0xE0042477E8E6FD3FULL, 0x4398128F3BBEAC39ULL, 0x01990AE0677D4325ULL, 0x39FF397D35B6988DULL,
+        0xD5FB6BDCAD5EDB23ULL, 0xF0A0E075401360D1ULL,
+    },
+    {
+        0x308C6B3869BCCA81ULL, 0x1CD513E91C38FBA3ULL, 0x6643F20F7DB85B75ULL, 0x6713012751DA678BULL,
+        0x1D67DBE666CAD429ULL, 0x6FA8D8D8F2066506ULL, 0xB321C89405B1C02EULL, 0x8A50600D7BFAEB4BULL,
+        0xB861175D56632F33ULL, 0x3302652B24073F89ULL,
+    },
+    {
+        0x7EB8E744062C7274ULL, 0xF5B52544F709AED1ULL, 0x26EE9FD12C30D3A9ULL, 0x10EB17009AA7A140ULL,
+        0xA0984F5A798C57B2ULL, 0xA5BAC0587CD49949ULL, 0xB631CBD99EBA3323ULL, 0xE30CD327F18F154BULL,
+        0xF0C86A24A28E0028ULL, 0x494914EF9A1EC9D3ULL,
+    },
+    {
+        0xAEED81F8980F3896ULL, 0x605480FF19107D8FULL, 0xEC7D077A61AFB213ULL, 0x5B8368416C80EE73ULL,
+        0x94AD1FC3655841D7ULL, 0x3CD525A45081769FULL, 0x8CD52D76D1B52529ULL, 0x5CF3888DBCE8DED3ULL,
+        0x51A87B1893FAB228ULL, 0xA3BF632474219948ULL,
+    },
+    {
+        0xDF26AD93FEE1BF4AULL, 0xDABF799E192791ACULL, 0x9D7966FF57AA1B39ULL, 0x73788F5DF42C3238ULL,
+        0x547C313F94260153ULL, 0xAF964E8A8B50FC1BULL, 0x6A18CA8D204C294AULL, 0x9FA555C7EF7ACE18ULL,
+        0xF63074270F699EFBULL, 0x73DE963E9653FE1FULL,
+    },
+    {
+        0x59F70FE457C1520FULL, 0x484460D22A5A2DEAULL, 0x64671949994FF8CCULL, 0xC77410303429F1DEULL,
+        0x314F25181E1F9AA1ULL, 0x4275D5E92E88DDA9ULL, 0x88FA7A77E95A4940ULL, 0x33AACD0D9131DA22ULL,
+        0x540DCB9284CED9E7ULL, 0x007B96EE018BBE2EULL,
+    },
+    {
+        0x25CE21302EB52D03ULL, 0xA299D77F1CD8AA48ULL, 0x1E45FF2160E3DD6DULL, 0x767E1A4DDA6B8BBCULL,
+        0x79633DA0648156E5ULL, 0x7E600A43BD612484ULL, 0xF020DF6948964C9AULL, 0x13D2D495884FA1D1ULL,
+        0xB4D9C1598D6324EAULL, 0x385136034CCEAFC9ULL,
+    },
+    {
+        0x43D048C6C6C345E5ULL, 0xBD02670D728654D4ULL, 0x524A54560C112164ULL, 0x57A8524AC9329B1FULL,
+        0xCC6AD505712B516BULL, 0x7E4BBBCA18C2F296ULL, 0x7EFE7417B0A17995ULL, 0xEBE7319B4C1706DBULL,
+        0xDE47719184575FAFULL, 0xA36F88AE7133AA12ULL,
+    },
+    {
+        0xB8976C87A6099A8FULL, 0xBD4A5B1AAAF7A528ULL, 0x155EEC504FC6DC97ULL, 0x25C95E46688BA768ULL,
+        0xE22BAFF6E5A5EC79ULL, 0x074CD67500F212F9ULL, 0x3309048A205AD8DDULL, 0xD5DD946FD5FEF516ULL,
+        0xFB91A46A062AB458ULL, 0xBFD57F686FCA9493ULL,
+    },
+    {
+        0xCE06EC5E168EB5F8ULL, 0x26B52A01FEE810F1ULL, 0x5547686B566125B2ULL, 0x37F90B1B6AC404C0ULL,
+        0x6436A035048E51B2ULL, 0x3BFE9F1628D0E237ULL, 0x145054B6C176DD90ULL, 0xA05A01AF8283149BULL,
+        0x802D09DF4B208C3AULL, 0x0C16AB0BDD7ECE25ULL,
+    },
+    {
+        0x72217BC7FD95134FULL, 0x7ADD162ECCA3AA72ULL, 0x570AD91FEB495CE2ULL, 0xB581FFF29F4CDF8EULL,
+        0x106542C44E3B5910ULL, 0x2DBB691DF40B35A8ULL, 0x74ACB216B056E5DBULL, 0x2EE1EDDD288A81C5ULL,
+        0xA94786DB5D4D6F14ULL, 0x2AE75398AF036E97ULL,
+    },
+    {
+        0x2DCC740C6EF9EDFFULL, 0xBDB87490A5F2CF25ULL, 0x7E4634CBEAE83DF0ULL, 0x81CF9FF93EA7A509ULL,
+        0xD56698FBD4CB2CA2ULL, 0xC1D107AFB019C499ULL, 0x9FE8109FA8387564ULL, 0x8F50AB86916BEEC3ULL,
+        0xD55A9CB5BD9CB022ULL, 0x611A3CBFED6D5ED3ULL,
+    },
+    {
+        0x8B3B24175F060A3EULL, 0xBC2C5ACA56262DBCULL, 0xAFC364C1445A8101ULL, 0xE46C1D69DBE0CB4EULL,
+        0x11888837CE82555AULL, 0xEFD1576E6D58C8B0ULL, 0xD650A27C695DB0E3ULL, 0xDD9509DF0D079D08ULL,
+        0x84D280BA225D3747ULL, 0x12763498F56EEE17ULL,
+    },
+    {
+        0xB7B25CEC3197EDDDULL, 0x714E4FF04F6BC002ULL, 0x00247E4E1F5B7CC0ULL, 0x211D0C9761BD735CULL,
+        0xE46C72F3299DAF0DULL, 0xB7A4D96AADD9C011ULL, 0x4CCB6EC78C21F268ULL, 0xF28445B4AF3E84E6ULL,
+        0x9D5D1BC1CBA5816FULL, 0x2DF28192619F7781ULL,
+    },
+    {
+        0x218B1AE2F1571395ULL, 0x575163B66A6FA143ULL, 0xAFE81B9692EF0E65ULL, 0x2574BE2C6099E79CULL,
+        0xB187B81991640C2EULL, 0xA8C7150886295EB5ULL, 0x5705BAD2013C57B1ULL, 0xCA1782D10A0662F0ULL,
+        0x13F77C28E25787A2ULL, 0x3FE7806F1E58763CULL,
+    },
+    {
+        0x1FCA0A3C7C51BA73ULL, 0xB3E18A1CBDA7849FULL, 0x6C180076E08570BAULL, 0x2C790368A8F678F9ULL,
+        0xFC73E1184ABA7FFEULL, 0x5932F8372AC4D89DULL, 0x8C3775B69C7167B0ULL, 0x646DA430A2B2872EULL,
+        0xA5212B522A2E1C79ULL, 0xC2F0BCEFDA6790ECULL,
+    },
+    {
+        0xCF23884B289D95DEULL, 0xB28D12160E6F3D08ULL, 0x5EEDE978EF33F797ULL, 0xDDC78347693B5C64ULL,
+        0xEDC13080171217FAULL, 0x5394F28A145C830CULL, 0xE282FEE38804FF65ULL, 0x6C3E314208724503ULL,
+        0xFD73546C6E4F6EC0ULL, 0xE4FC5F150DC707E0ULL,
+    },
+    {
+        0x07CA9F0DE21409B8ULL, 0xB85B03E462C9563FULL, 0xA81439CDB253D285ULL, 0x63CFE42C5407A7DCULL,
+        0x3AFCD806B18CEA99ULL, 0x95EF91CFC44A1536ULL, 0xD009028D34612857ULL, 0x0D2CF08BC9885938ULL,
+        0xEB942EDCFFBC4B7DULL, 0x85BE8EEB283AFB8FULL,
+    },
+    {
+        0x43A4C210F0992CD1ULL, 0x25D7DD8D89DEFF7EULL, 0x7701F36819EC8EEFULL, 0x0682953025543E3EULL,
+        0x58007F9E1F38D432ULL, 0xF55F19BBA9E758E1ULL, 0x84EA960A1F9BF6F7ULL, 0xDBC7BF6E741EC2F5ULL,
+        0x91E027F860A38231ULL, 0x01310108E7736689ULL,
+    },
+    {
+        0xC819819582D450D0ULL, 0xB43215A74F719285ULL, 0x71F73C82BF6CF1E9ULL, 0x06797A3740064CEEULL,
+        0xAA3DDA45D260C6FEULL, 0x605969134F8EC9D9ULL, 0x95B868C308DA3913ULL, 0x2FC5403577156BD1ULL,
+        0x441E2FEC42C65597ULL, 0xFF0910D7E5577171ULL,
+    },
+    {
+        0x394415411715D534ULL, 0x32BEAE42E241D47DULL, 0x4B2CA33C6B5E4095ULL, 0x46048C95AE532775ULL,
+        0x7D380FAF1A94ED28ULL, 0x115458CF3215A2C7ULL, 0xCB98EC153C701ED8ULL, 0x18622FC3B385F344ULL,
+        0x7162F1C38A4FBB85ULL, 0xD9576154EC9A5527ULL,
+    },
+    {
+        0x6187BD85C3B329A5ULL, 0x689C4D89F6CB3C71ULL, 0x02C391A10AC3FF7BULL, 0xAC7EAAD569E6DF4BULL,
+        0xBF7386C0CEE466E5ULL, 0xFAD49975076064B4ULL, 0xE25CE7E19ED79B1BULL, 0xFA0D8B93A1AC1C2CULL,
+        0x16C1DF91CAC6F7C9ULL, 0x5DF4319B2615446FULL,
+    },
+    {
+        0x39518E671562E817ULL, 0xB66D9401BD45901CULL, 0xCDE6361C2653EC22ULL, 0xAFB6532016E8FF07ULL,
+        0x1E4806E80A8427E3ULL, 0x150E3C8B2B3A31A6ULL, 0x008A082E8CE527A5ULL, 0x8FD19DC0B5943326ULL,
+        0xF21FD6C11CEFD747ULL, 0xCA0C098061BD122FULL,
+    },
+    {
+        0x266A77E1BBF4D828ULL, 0x209B21CFDDD924B7ULL, 0x97B22AC087E34517ULL, 0xD589A8D526C2D47AULL,
+        0x0CF7C524E6189813ULL, 0xC5BA74838A1B9961ULL, 0x58044C0D6901D392ULL, 0x18E24DBA1A291427ULL,
+        0x7C8C277286A89D29ULL, 0x9B59D2126429026BULL,
+    },
+    {
+        0x8B193B46FB2FE080ULL, 0x0CFC2CF8D1AB3EACULL, 0x6137D6A5C5925B6DULL, 0x986DD6422CB2B30BULL,
+        0x4E37B7CD760598C7ULL, 0xE5AA693E4D8B488BULL, 0x0531F34D447F72B6ULL, 0xE8FA0370C13503C1ULL,
+        0xBC6A1BE4105CBBC2ULL, 0x5CC4F1A81FAAFD37ULL,
+    },
+    {
+        0x5F2702CEA6FE727EULL, 0xCAE888C032DD0919ULL, 0x426726E55C7C3F33ULL, 0x345C9775174F23B5ULL,
+        0xB531A50893959720ULL, 0xAFB6CAC48667F892ULL, 0xEB19D581D6DC3ECAULL, 0xFA73BEF40F75AE8BULL,
+        0x034B943F5DFA82BAULL, 0xAFC19295ED9A60C0ULL,
+    },
+    {
+        0xD33E78AD0B7FA991ULL, 0x82C83420215E385EULL, 0xA51D0C63FBB664DFULL, 0xF773ED2A7888982FULL,
+        0xC7FA789B9C070E53ULL, 0xFB3860857E48FB3FULL, 0xE9709822B0C34016ULL, 0x19C88F4438787A22ULL,
+        0x5DB52CD41DB7F8D1ULL, 0x7452BC6C42EF8D15ULL,
+    },
+    {
+        0x59EDB05CE1800317ULL, 0x6F930D0F2E81B526ULL, 0x38C30DB75ABCE252ULL, 0xBE6A3FF0599CDE7DULL,
+        0x30C7C9551676E47AULL, 0xE93479292F21678EULL, 0x7EA4F267DBCCB56AULL, 0x8E65170AFE064368ULL,
+        0xA6ACA09EF28E52BEULL, 0x71B3857646FCC29BULL,
+    },
+    {
+        0x46FFE8DA471F610FULL, 0xAFBFAA2F7E33EC8CULL, 0xB99C64459CF448A9ULL, 0xAA07941D0FD51E55ULL,
+        0x056133A38965F70FULL, 0x9F106D9B8F408ECFULL, 0xC85F6E01C97DA4C1ULL, 0xD6EEA967848BCB72ULL,
+        0xEA4AD1D59F213504ULL, 0xF376244E4B359741ULL,
+    },
+    {
+        0xFAA1A843526E1E36ULL, 0x5BB60AC78EB56BF9ULL, 0xA132B92B3D73CCCFULL, 0x8756507C63E770D3ULL,
+        0xAC0AD263C8A7BDC6ULL, 0xEFD9AB4B261BB035ULL, 0x11F1FB3AC9A864E3ULL, 0x9510123A1115B08FULL,
+        0x20E3ABF23E8F384FULL, 0x1677907D171CCB86ULL,
+    },
+    {
+        0x7A0424E49C7E9054ULL, 0x408171B3717E59E2ULL, 0x25B8D8368EC48017ULL, 0x3508CD1569F7C74EULL,
+        0x7F8E5A5DEAF19038ULL, 0xCB357D592C795AC0ULL, 0x897BCD3518B81C47ULL, 0x67B49ADCC53CF152ULL,
+        0x8C17241FBEB62873ULL, 0xE3A5CB9F52B2F89DULL,
+    },
+    {
+        0xEDB157BA9CADD3BDULL, 0xCB8F9645582A0385ULL, 0x2A8E6D5BD0DB1DA5ULL, 0x59C3357A7F87BF51ULL,
+        0x8A231252460A0C8DULL, 0xA833EFBB94A1E36FULL, 0xE05D064EC30483B3ULL, 0x1AC51EB83B65F743ULL,
+        0xA7C7F4AA2A053323ULL, 0x2F7E924007D2CE3BULL,
+    },
+    {
+        0x2AE7F021132F15EFULL, 0x69B58F69F38515D6ULL, 0x1FF2B82ADB392E8DULL, 0x649EE8465E20CD6BULL,
+        0x6EA7683BAC61E644ULL, 0x0BF9770332652818ULL, 0xEE49BA58AB2B1D3DULL, 0x9F9DF66AFF4878A2ULL,
+        0xB2BEE7CF3D3A1A0EULL, 0x46D53F45F577BB81ULL,
+    },
+    {
+        0x02C71833DD5BF438ULL, 0xFD40362E0B2C21D8ULL, 0x00DE0C1589389ADFULL, 0x1BA862E3D609FD63ULL,
+        0x57A876B7B9AA67A7ULL, 0x16A71B4AD5B22859ULL, 0x2179AF0E527298E2ULL, 0xACCD091A1CE8DD9AULL,
+        0xF1704D5950A6D164ULL, 0x652995130F44781DULL,
+    },
+    {
+        0xF7F1A0851C6B7929ULL, 0x782258126BBDA935ULL, 0x8A710DCD25CF889BULL, 0x4B72B6542BC11BE3ULL,
+        0x06145964D392F6DFULL, 0x4EEEDCDA381F3E51ULL, 0x437DC0F48FD4BE1CULL, 0xB96852913B9DE5D0ULL,
+        0xA5F7FF8688B3D3D3ULL, 0x2D19D2E804B894BDULL,
+    },
+};
+
+const uint64_t ZOBRIST_CURRENT[7] = {
+    0x611819B13EDE9987ULL, 0x088F6C7D19E30EE1ULL, 0x9242912A281CC1E2ULL, 0xA6C7317CEF200634ULL,
+    0x69042098C55DCA4DULL, 0x960E603C72B86B64ULL, 0xFF321F3EFBA66EC0ULL,
+};
+
+const uint64_t ZOBRIST_HOLD[7] = {
+    0x0102A13ADACEB8C2ULL, 0x5A4F351587C0E1ECULL, 0xE9A940ECD5CF2768ULL, 0x23339D17DDAC3A66ULL,
+    0x466F836C9863E449ULL, 0x1388CF1FCC03733EULL, 0x2620321364A2888DULL,
+};
+
+const uint64_t ZOBRIST_HELD = 0x878CB841ED5E1BF8ULL;
+
+const uint64_t ZOBRIST_QUEUE[ZOBRIST_QUEUE_SIZE] = {
+    0xD6BB7EB32199BB2CULL, 0x1CD0CB8D9C2453B0ULL, 0xED3C3998EF2B1542ULL, 0xFD599DEEECC601D4ULL,
+    0x67DFDC6096BE0F13ULL, 0x83B06C11FEF1C5BAULL, 0x1BC8DD610D84B037ULL, 0x481303BE19198674ULL,
+    0xB3CAFCDEFE47EBA7ULL, 0x4DBE0191D2C63BD4ULL, 0x36FAACB383C8F6E1ULL, 0xC8425F22756B9644ULL,
+    0x10443B8228B44E15ULL, 0x0E2E00D3D9B7D2C8ULL, 0x368CCD993308A873ULL, 0x63C5D2EA3CFE1104ULL,
+    0xA8A579BF2E77569DULL, 0xAAE2538396A58329ULL, 0xC7E687FD84119416ULL, 0x3E0CA43DB5524814ULL,
+    0x19898DDD099F2A5EULL, 0x39B828AE7557D65AULL, 0x60F2A3658C8F9B16ULL, 0x1BE4D63CB92F209FULL,
+    0xB3775DFEBB15CB62ULL, 0xBF6713BE42988BF0ULL, 0x5C175B16CAD52692ULL, 0xCC88F93087EF9520ULL,
+    0x7E63CDC6D65C61E2ULL, 0xD86E9894225F2A4DULL, 0x5DF3AEEE1AFECF3AULL, 0x1A30A0DF845C6869ULL,
+    0xFF414C79DA54FFC6ULL, 0xF4CC5736B3965CDEULL, 0x577A0B0E4828D082ULL, 0xF7CE8001BC5EEE12ULL,
+    0x54B473F4A28AF73AULL, 0x42F65C4918BF638AULL, 0x21750B4039F0247FULL, 0x25E17B460D915E7CULL,
+    0xE064B5607C0D97DEULL, 0xE505E69002563181ULL, 0x5172EA9180F9F795ULL, 0xF066236C92E495CCULL,
+    0xFDB5F05AF95008E3ULL, 0x7950485FF371C769ULL, 0x3735A3CFC7BCA664ULL, 0x129E20066BAD6492ULL,
+    0x7F7AAB8A67A67ED2ULL, 0x1EC6532C0C4ED44DULL, 0x70A31639C07438F7ULL, 0x06078EF39B01CE6FULL,
+    0xF0A1D2542B3750C9ULL, 0xF10F847B52F64044ULL, 0x4104D13CA3011204ULL, 0xCCD792BCDAAC5270ULL,
+    0xF1299ADED9076E0AULL, 0x328280933C02661EULL, 0x255AFD947D0F9563ULL, 0xA39C4C0FDB483D30ULL,
+    0x4670E593844B5FD9ULL, 0x91407C10B12B31EDULL, 0xE69ABE276189A764ULL, 0xEF65C2C4845FC7DEULL,
+};
+
+//moves a shape row to column x of the board. anything pushed past the left edge sets bit 0 so it still hits the wall
+uint32_t placeRow(uint16_t row, int x) {
+    int shift = x + WALL_OFFSET;
+    if (shift < 0) {
+        return (row >> -shift) | ((row & ((1u << -shift) - 1)) != 0);
+    }
+    return (uint32_t) row << shift;
+}
+
+bool collides(struct board *matrix, int type, int rotation, int x, int y) {
+    const uint16_t *rows = SHAPES[type][rotation].rows;
+    int i;
+    for (i = 0; i < 4; i++) {
+        if (rows[i]) {
+            if (y - i < 0 || y - i >= BOARD_HEIGHT) {
+                return true;
+            }
+            //bits above 15 are off the right of the board so they count as wall too
+            if (placeRow(rows[i], x) & (matrix->rows[y - i] | 0xFFFF0000u)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void emptyMatrix(struct board *matrix) {
+    int i, j;
+    for (i = 0; i < BOARD_HEIGHT; i++) {
+        matrix->rows[i] = EMPTY_ROW;
+        for (j = 0; j < BOARD_WIDTH; j++) {
+            matrix->colours[i][j] = 0;
+        }
+    }
+    memset(matrix->heights, 0, BOARD_WIDTH);
+}
+
+void updateHeights(struct board *matrix) {
+    memset(matrix->heights, 0, BOARD_WIDTH);
+    //from the top down, the first row a column has a block in is its height
+    uint16_t found = 0;
+    int y;
+    for (y = BOARD_HEIGHT - 1; y >= 0 && found != FIELD_MASK; y--) {
+        uint16_t blocks = matrix->rows[y] & FIELD_MASK & ~found;
+        found |= blocks;
+        while (blocks) {
+            matrix->heights[__builtin_ctz(blocks) - WALL_OFFSET] = y + 1;
+            blocks &= blocks - 1;
+        }
+    }
+}
+
+int getDroppedPos(struct board *matrix, struct tetromino piece) {
+    //with every block at or above the top of its column, the drop is the smallest gap between a block and the stack under it
+    const struct piece_shape *shape = &SHAPES[piece.type][piece.rotation];
+    int drop = BOARD_HEIGHT;
+    bool clear = true;
+    int i;
+    for (i = 0; i < 4 && clear; i++) {
+        if (shape->bottoms[i] < 0) {
+            continue;
+        }
+        int column = piece.x + i;
+        int bottom = piece.y - shape->bottoms[i];
+        clear = column >= 0 && column < BOARD_WIDTH && bottom >= matrix->heights[column];
+        if (clear && bottom - matrix->heights[column] < drop) {
+            drop = bottom - matrix->heights[column];
+        }
+    }
+    if (clear) {
+        return drop;
+    }
+
+    //tucked under an overhang, where the stack above says nothing about what's below
+    drop = 0;
+    while (!collides(matrix, piece.type, piece.rotation, piece.x, piece.y - drop - 1)) {
+        drop = drop + 1;
+    }
+    return drop;
+}
+
+//xorshift64*, small and fast and good enough for shuffling bags
+uint32_t nextRandom(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (*state * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+//here we shuffle a new bag of the 7 pieces onto the end of the queue
+void extendUpcoming(struct game_data *data) {
+    uint8_t bag[7] = {PIECE_I, PIECE_T, PIECE_Z, PIECE_S, PIECE_L, PIECE_J, PIECE_O};
+    int i;
+    for (i = 6; i > 0; i--) {
+        int random = nextRandom(&data->random) % (i + 1);
+        uint8_t temp = bag[i];
+        bag[i] = bag[random];
+        bag[random] = temp;
+    }
+    for (i = 0; i < 7; i++) {
+        data->upcoming[(data->upcoming_start + data->upcoming_count) & (UPCOMING_SIZE - 1)] = bag[i];
+        data->upcoming_count = data->upcoming_count + 1;
+    }
+}
+
+int upcomingPiece(struct game_data *data, int i) {
+    return data->upcoming[(data->upcoming_start + i) & (UPCOMING_SIZE - 1)];
+}
+
+struct tetromino spawnPiece(int type) {
+    return (struct tetromino) {type, 0, 3, 20};
+}
+
+bool newCurrent(struct game_data *data) {
+    data->current = spawnPiece(upcomingPiece(data, 0));
+    data->hash ^= ZOBRIST_QUEUE[data->drawn % ZOBRIST_QUEUE_SIZE] ^ ZOBRIST_QUEUE[(data->drawn + 1) % ZOBRIST_QUEUE_SIZE];
+    data->hash ^= ZOBRIST_CURRENT[data->current.type];
+    data->drawn = data->drawn + 1;
+    data->upcoming_start = (data->upcoming_start + 1) & (UPCOMING_SIZE - 1);
+    data->upcoming_count = data->upcoming_count - 1;
+    //keep at least a full bag queued so there are always enough previews
+    if (data->upcoming_count < 7) {
+        extendUpcoming(data);
+    }
+    return !collides(&data->matrix, data->current.type, data->current.rotation, data->current.x, data->current.y);
+}
+
+//rows per tick a piece falls at level, BOARD_HEIGHT if it falls straight to the stack
+double levelGravity(const struct settings *settings, int level) {
+    double base = settings->gravity_base - (level - 1) * settings->gravity_step;
+    //once the curve's base runs out it has no sensible speed left, so treat it as the fastest
+    double seconds = base > 0 ? pow(base, level - 1) : 0;
+    if (settings->instant_gravity || seconds * TICK_RATE * BOARD_HEIGHT <= 1) {
+        return BOARD_HEIGHT;
+    }
+    return 1 / (seconds * TICK_RATE);
+}
+
+void applySettings(struct game_data *data, struct settings settings) {
+    data->settings = settings;
+    int level;
+    for (level = 1; level <= GRAVITY_LEVELS; level++) {
+        data->gravity[level - 1] = levelGravity(&settings, level);
+    }
+    data->sdrop_rows = settings.sdrop_gravity * TICK_RATE * BOARD_HEIGHT > 1 ? 1 / (settings.sdrop_gravity * TICK_RATE) : BOARD_HEIGHT;
+}
+
+void initGame(struct game_data *data, uint64_t seed) {
+    applySettings(data, default_settings);
+    //xorshift can't start from 0 and nearby seeds should still give different games
+    data->random = (seed ^ 0x9E3779B97F4A7C15ULL) * 0xBF58476D1CE4E5B9ULL;
+    if (data->random == 0) {
+        data->random = 1;
+    }
+    data->upcoming_start = 0;
+    data->upcoming_count = 0;
+    data->drawn = 0;
+    extendUpcoming(data);
+    extendUpcoming(data);
+    emptyMatrix(&data->matrix);
+    data->board_version = 0;
+    newCurrent(data);
+    data->level = 1;
+    data->score = 0;
+    data->time = 0;
+    data->fallen = 0;
+    data->right_das = 0;
+    data->left_das = 0;
+    data->last_das_move = 0;
+    data->locking = false;
+    data->started_locking = 0;
+    data->holding = false;
+    data->has_been_held = false;
+    data->lines = 0;
+    data->pieces = 0;
+    data->cleared_count = 0;
+    data->over = false;
+    data->hash = gameHash(data);
+}
+
+uint64_t rowHash(int y, uint16_t row) {
+    uint64_t hash = 0;
+    unsigned cells = row & FIELD_MASK;
+    while (cells) {
+        hash ^= ZOBRIST_CELLS[y][__builtin_ctz(cells) - WALL_OFFSET];
+        cells &= cells - 1;
+    }
+    return hash;
+}
+
+uint64_t stackHash(const uint16_t rows[BOARD_HEIGHT], int bottom) {
+    uint64_t hash = 0;
+    int y;
+    for (y = bottom; y < BOARD_HEIGHT && rows[y] != EMPTY_ROW; y++) {
+        hash ^= rowHash(y, rows[y]);
+    }
+    return hash;
+}
+
+uint64_t stateHash(int current, int hold, int drawn, bool has_been_held) {
+    uint64_t hash = ZOBRIST_QUEUE[drawn % ZOBRIST_QUEUE_SIZE];
+    if (current >= 0) {
+        hash ^= ZOBRIST_CURRENT[current];
+    }
+    if (hold >= 0) {
+        hash ^= ZOBRIST_HOLD[hold];
+    }
+    if (has_been_held) {
+        hash ^= ZOBRIST_HELD;
+    }
+    return hash;
+}
+
+uint64_t gameHash(struct game_data *data) {
+    uint64_t hash = stateHash(data->current.type, data->holding ? data->hold_piece.type : -1, data->drawn, data->has_been_held);
+    int y;
+    for (y = 0; y < BOARD_HEIGHT; y++) {
+        hash ^= rowHash(y, data->matrix.rows[y]);
+    }
+    return hash;
+}
+
+//rows per tick gravity pulls the current piece down at, soft drop only ever makes it faster
+double currentGravity(struct game_data *data, bool sdrop) {
+    double rows = data->gravity[(data->level < GRAVITY_LEVELS ? data->level : GRAVITY_LEVELS) - 1];
+    return sdrop && data->sdrop_rows > rows ? data->sdrop_rows : rows;
+}
+
+//builds up dt seconds of gravity and drops the piece every whole row of it at once, stopping at the stack
+void tryDrop(struct game_data *data, double dt, bool sdrop) {
+    data->fallen = data->fallen + currentGravity(data, sdrop) * dt * TICK_RATE;
+    if (data->fallen < 1) {
+        return;
+    }
+    int rows = data->fallen < BOARD_HEIGHT ? (int) data->fallen : BOARD_HEIGHT;
+    data->fallen = data->fallen < BOARD_HEIGHT ? data->fallen - rows : 0;
+    int distance = getDroppedPos(&data->matrix, data->current);
+    data->current.y = data->current.y - (rows < distance ? rows : distance);
+}
+
+bool overflows(struct tetromino piece) {
+    const struct offset *cells = SHAPES[piece.type][piece.rotation].cells;
+    int i;
+    for (i = 0; i < 4; i++) {
+        if (piece.y - cells[i].y < 20) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int getDASsedPos(struct board *matrix, struct tetromino piece, int direction) {
+    int x = piece.x;
+    while (!collides(matrix, piece.type, piece.rotation, x + direction, piece.y)) {
+        x = x + direction;
+    }
+    return x;
+}
+
+//tries each kick for the rotation in turn and keeps the first that fits
+bool rotatePiece(struct board *matrix, struct tetromino *piece, int amount) {
+    int rotation = (piece->rotation + amount) % 4;
+    if (piece->type == PIECE_O) {
+        piece->rotation = rotation;
+        return true;
+    }
+    const struct offset *kicks = KICKS[piece->type == PIECE_I][piece->rotation][amount - 1];
+    int i;
+    for (i = 0; i < KICK_TESTS; i++) {
+        if (!collides(matrix, piece->type, rotation, piece->x + kicks[i].x, piece->y + kicks[i].y)) {
+            piece->rotation = rotation;
+            piece->x = piece->x + kicks[i].x;
+            piece->y = piece->y + kicks[i].y;
+            return true;
+        }
+    }
+    return false;
+}
+
+//removes the full rows between bottom and top and moves the rows above down over them in a single pass
+//the cleared rows are written to cleared from the bottom up and the number of them is returned
+int clearLines(struct board *matrix, int bottom, int top, int cleared[4]) {
+    TRACE_ZONE("clearLines");
+    int count = 0;
+    int i;
+    for (i = bottom; i <= top; i++) {
+        if (matrix->rows[i] == FULL_ROW) {
+            cleared[count] = i;
+            count = count + 1;
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    int to = cleared[0];
+    for (i = cleared[0]; i < BOARD_HEIGHT; i++) {
+        //nothing can rest on an empty row so everything above it is empty too
+        if (i > top && matrix->rows[i] == EMPTY_ROW) {
+            break;
+        }
+        if (i <= top && matrix->rows[i] == FULL_ROW) {
+            continue;
+        }
+        matrix->rows[to] = matrix->rows[i];
+        memcpy(matrix->colours[to], matrix->colours[i], BOARD_WIDTH);
+        to = to + 1;
+    }
+    for (; to < i; to++) {
+        matrix->rows[to] = EMPTY_ROW;
+        memset(matrix->colours[to], 0, BOARD_WIDTH);
+    }
+    updateHeights(matrix);
+    return count;
+}
+
+bool lockPiece(struct game_data *data) {
+    TRACE_ZONE("lockPiece");
+    struct tetromino *piece = &data->current;
+    struct board *matrix = &data->matrix;
+    if (data->has_been_held) {
+        data->hash ^= ZOBRIST_HELD;
+    }
+    data->has_been_held = false;
+    data->pieces = data->pieces + 1;
+    data->board_version = data->board_version + 1;
+    data->hash ^= ZOBRIST_CURRENT[piece->type];
+    const struct piece_shape *shape = &SHAPES[piece->type][piece->rotation];
+    int top = -1;
+    int bottom = BOARD_HEIGHT;
+    int full = BOARD_HEIGHT;
+    int i;
+    for (i = 0; i < 4; i++) {
+        if (shape->rows[i]) {
+            uint32_t placed = placeRow(shape->rows[i], piece->x);
+            data->hash ^= rowHash(piece->y - i, placed);
+            matrix->rows[piece->y - i] |= placed;
+            full = matrix->rows[piece->y - i] == FULL_ROW ? piece->y - i : full;
+            top = top > piece->y - i ? top : piece->y - i;
+            bottom = piece->y - i;
+        }
+        matrix->colours[piece->y - shape->cells[i].y][piece->x + shape->cells[i].x] = names[piece->type];
+        if (matrix->heights[piece->x + shape->cells[i].x] < piece->y - shape->cells[i].y + 1) {
+            matrix->heights[piece->x + shape->cells[i].x] = piece->y - shape->cells[i].y + 1;
+        }
+    }
+
+    //everything from the lowest full row up moves, so swap out its hash
+    if (full < BOARD_HEIGHT) {
+        data->hash ^= stackHash(matrix->rows, full);
+    }
+    data->cleared_count = clearLines(matrix, bottom, top, data->cleared_rows);
+    if (full < BOARD_HEIGHT) {
+        data->hash ^= stackHash(matrix->rows, full);
+    }
+    if (data->cleared_count > 0) {
+        data->score = data->score + data->settings.scoring[data->cleared_count-1]*data->level;
+        data->lines = data->lines + data->cleared_count;
+        data->level = (int) data->lines / 10 + 1;
+    }
+
+    if (overflows(*piece) || !newCurrent(data)) {
+        data->over = true;
+        return false;
+    }
+    return true;
+}
+
+bool holdPiece(struct game_data *data) {
+    data->locking = false;
+    data->hash ^= ZOBRIST_CURRENT[data->current.type] ^ ZOBRIST_HOLD[data->current.type];
+    if (!data->has_been_held) {
+        data->hash ^= ZOBRIST_HELD;
+    }
+    if (!data->holding) {
+        data->holding = true;
+        data->hold_piece = data->current;
+        if (!newCurrent(data)) {
+            data->over = true;
+            return false;
+        }
+    } else {
+        data->hash ^= ZOBRIST_CURRENT[data->hold_piece.type] ^ ZOBRIST_HOLD[data->hold_piece.type];
+        struct tetromino temp = data->current;
+        data->current = data->hold_piece;
+        data->hold_piece = temp;
+    }
+    data->hold_piece = spawnPiece(data->hold_piece.type);
+    data->has_been_held = true;
+    return true;
+}
+
+bool placePiece(struct game_data *data, int rotation, int x, int y) {
+    data->current.rotation = rotation;
+    data->current.x = x;
+    data->current.y = y;
+    data->locking = false;
+    return lockPiece(data);
+}
+
+bool gameKeyboardHandling(struct game_data *data, struct presses pressed, struct presses just_pressed, double elapsed_time) {
+    TRACE_ZONE("gameKeyboardHandling");
+    if (pressed.left) {
+        if (elapsed_time > data->left_das + data->settings.das) {
+            if (data->settings.arr == 0) {
+                data->current.x = getDASsedPos(&data->matrix, data->current, -1);
+            }
+            else if (elapsed_time > data->last_das_move + data->settings.arr) {
+                if(!collides(&data->matrix, data->current.type, data->current.rotation, data->current.x - 1, data->current.y)) {
+                    data->current.x = data->current.x - 1;
+                    data->last_das_move = elapsed_time;
+                }
+            }
+        } else {
+            data->last_das_move = elapsed_time;
+        }
+    } else {
+        data->left_das = elapsed_time;
+    }
+
+    if (pressed.right) {
+        if (elapsed_time > data->right_das + data->settings.das) {
+            if (data->settings.arr == 0) {
+                data->current.x = getDASsedPos(&data->matrix, data->current, 1);
+            }
+            else if (elapsed_time > data->last_das_move + data->settings.arr) {
+                if(!collides(&data->matrix, data->current.type, data->current.rotation, data->current.x + 1, data->current.y)) {
+                    data->current.x = data->current.x + 1;
+                    data->last_das_move = elapsed_time;
+                }
+            }
+        } else {
+            data->last_das_move = elapsed_time;
+        }
+    } else {
+        data->right_das = elapsed_time;
+    }
+
+    if (just_pressed.left) {
+        if (!collides(&data->matrix, data->current.type, data->current.rotation, data->current.x - 1, data->current.y)) {
+            data->current.x = data->current.x - 1;
+            data->locking = false;
+        }
+    }
+
+    if (just_pressed.right) {
+        if (!collides(&data->matrix, data->current.type, data->current.rotation, data->current.x + 1, data->current.y)) {
+            data->current.x = data->current.x + 1;
+            data->locking = false;
+        }
+    }
+
+    if (just_pressed.rotc || just_pressed.rota || just_pressed.rot180) {
+        int amount = 0;
+        if (just_pressed.rotc) {
+            amount = 1;
+        } else if (just_pressed.rota) {
+            amount = 3;
+        } else if (just_pressed.rot180) {
+            amount = 2;
+        }
+        if (rotatePiece(&data->matrix, &data->current, amount)) {
+            data->locking = false;
+        }
+    }
+
+    if (just_pressed.hdrop) {
+        data->current.y = data->current.y - getDroppedPos(&data->matrix, data->current);
+        if (!lockPiece(data)) {
+            return false;
+        }
+        data->locking = false;
+    }
+
+    if (just_pressed.hold && !data->has_been_held) {
+        if (!holdPiece(data)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool gameGravity(struct game_data *data, struct presses pressed, double dt, double elapsed_time) {
+    TRACE_ZONE("gameGravity");
+    tryDrop(data, dt, pressed.sdrop);
+
+    if (collides(&data->matrix, data->current.type, data->current.rotation, data->current.x, data->current.y - 1)) {
+        if (data->locking) {
+            if (elapsed_time > data->started_locking + data->settings.lock_delay) {
+                if (!lockPiece(data)) {
+                    return false;
+                }
+                data->locking = false;
+            }
+        } else {
+            data->locking = true;
+            data->started_locking = elapsed_time;
+        }
+    } else {
+        data->locking = false;
+    }
+    return true;
+}
+
+bool gameStep(struct game_data *data, struct inputs inputs, double dt) {
+    if (data->over) {
+        return false;
+    }
+    data->time = data->time + dt;
+
+    if (!gameGravity(data, inputs.pressed, dt, data->time)) {
+        return false;
+    }
+
+    if (!gameKeyboardHandling(data, inputs.pressed, inputs.just_pressed, data->time)) {
+        return false;
+    }
+    //at 20G a piece that was moved off the stack, or has just spawned, is back down on it straight away
+    if (currentGravity(data, false) >= BOARD_HEIGHT) {
+        data->current.y = data->current.y - getDroppedPos(&data->matrix, data->current);
+    }
+    return true;
+}
+
+bool *pressesKey(struct presses *presses, int key) {
+    switch (key) {
+        case KEY_ROTC:
+            return &presses->rotc;
+        case KEY_SDROP:
+            return &presses->sdrop;
+        case KEY_RIGHT:
+            return &presses->right;
+        case KEY_LEFT:
+            return &presses->left;
+        case KEY_ENTER:
+            return &presses->enter;
+        case KEY_HDROP:
+            return &presses->hdrop;
+        case KEY_ROTA:
+            return &presses->rota;
+        case KEY_ROT180:
+            return &presses->rot180;
+        case KEY_HOLD:
+            return &presses->hold;
+        case KEY_QUIT:
+            return &presses->quit;
+        default:
+            return NULL;
+    }
+}
+
+void initTicker(struct ticker *ticker, double now) {
+    memset(ticker, 0, sizeof(struct ticker));
+    ticker->time = now;
+    ticker->now = now;
+}
+
+bool tickerPush(struct ticker *ticker, struct key_event event) {
+    if (pressesKey(&ticker->pressed, event.key) == NULL) {
+        return false;
+    }
+    //when the queue is full the oldest event takes effect now instead of on its tick. a tap can be lost that way
+    //but never a release, which would leave the key held
+    if (ticker->count == TICKER_EVENTS) {
+        struct key_event *oldest = &ticker->events[ticker->first];
+        *pressesKey(&ticker->pressed, oldest->key) = oldest->down;
+        ticker->first = (ticker->first + 1) % TICKER_EVENTS;
+        ticker->count = ticker->count - 1;
+    }
+    ticker->events[(ticker->first + ticker->count) % TICKER_EVENTS] = event;
+    ticker->count = ticker->count + 1;
+    return true;
+}
+
+void tickerAdvance(struct ticker *ticker, double now) {
+    ticker->now = now;
+    //the game stands still through a stall rather than playing it all out at once, and keys pressed during it land on the first tick
+    if (now - ticker->time > TICKER_MAX_CATCH_UP) {
+        ticker->time = now - TICKER_MAX_CATCH_UP;
+    }
+}
+
+bool tickerNext(struct ticker *ticker, struct inputs *inputs) {
+    if (ticker->now - ticker->time < 1.0 / TICK_RATE) {
+        return false;
+    }
+    ticker->time = ticker->time + 1.0 / TICK_RATE;
+    struct presses just_pressed;
+    memset(&just_pressed, 0, sizeof(struct presses));
+    while (ticker->count > 0) {
+        struct key_event *event = &ticker->events[ticker->first];
+        if (event->time >= ticker->time) {
+            break;
+        }
+        //a second press of the same key waits for the next tick, so quick taps aren't merged into one
+        bool *was_pressed = pressesKey(&just_pressed, event->key);
+        if (event->down && *was_pressed) {
+            break;
+        }
+        if (event->down) {
+            *was_pressed = true;
+        }
+        *pressesKey(&ticker->pressed, event->key) = event->down;
+        ticker->first = (ticker->first + 1) % TICKER_EVENTS;
+        ticker->count = ticker->count - 1;
+    }
+    inputs->pressed = ticker->pressed;
+    inputs->just_pressed = just_pressed;
+    return true;
+}
@@ -0,0 +1,256 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+//the rules of the game, kept free of SDL so they can run without a display
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SDROP_GRAVITY 0.05
+#define LOCK_DELAY 0.5
+#define DAS 0.133
+#define ARR 0.02
+//seconds per row at level n is (GRAVITY_BASE - (n-1)*GRAVITY_STEP)^(n-1)
+#define GRAVITY_BASE 0.8
+#define GRAVITY_STEP 0.007
+//levels with their own entry in the gravity table, later levels fall as fast as the last one
+//with the default curve the last few are already past a whole board a tick
+#define GRAVITY_LEVELS 32
+//logic ticks per second when playing in real time, however fast frames are drawn
+#define TICK_RATE 1000
+//most seconds of ticks run to catch up to a frame, after a stall like dragging the window the rest is skipped
+#define TICKER_MAX_CATCH_UP 0.25
+
+#define BOARD_WIDTH 10
+#define BOARD_HEIGHT 40
+
+//each row of the board is a 16 bit mask with the 10 columns in bits 3-12
+//the bits either side are always set so that the walls collide like any other block
+#define WALL_OFFSET 3
+#define EMPTY_ROW 0xE007
+#define FULL_ROW 0xFFFF
+//the columns of a row, without the walls
+#define FIELD_MASK 0x1FF8
+
+#define KICK_TESTS 5
+
+//size of the ring buffer of upcoming pieces, a power of 2 that fits two bags
+#define UPCOMING_SIZE 16
+
+//how many queue positions get their own hash key, positions this far apart share one
+#define ZOBRIST_QUEUE_SIZE 64
+
+struct board {
+    uint16_t rows[BOARD_HEIGHT];
+    //type of the piece that filled each cell, 0 when empty. only the renderer reads this
+    char colours[BOARD_HEIGHT][BOARD_WIDTH];
+    //one more than the highest filled row of each column, 0 for an empty column. kept up to date by lockPiece and clearLines
+    uint8_t heights[BOARD_WIDTH];
+};
+
+struct tetromino {
+    int type;
+    int rotation;
+    int x;
+    int y;
+};
+
+struct presses {
+    bool rotc;
+    bool sdrop;
+    bool right;
+    bool left;
+    bool enter;
+    bool hdrop;
+    bool rota;
+    bool rot180;
+    bool hold;
+    bool quit;
+};
+
+//one for each key in struct presses, in the same order
+enum keys {
+    KEY_ROTC,
+    KEY_SDROP,
+    KEY_RIGHT,
+    KEY_LEFT,
+    KEY_ENTER,
+    KEY_HDROP,
+    KEY_ROTA,
+    KEY_ROT180,
+    KEY_HOLD,
+    KEY_QUIT,
+    KEYS
+};
+
+//pressed is what is held down, just_pressed is what went down since the last step
+struct inputs {
+    struct presses pressed;
+    struct presses just_pressed;
+};
+
+#define TICKER_EVENTS 64
+
+struct key_event {
+    //seconds, on the same clock as the times given to the ticker
+    double time;
+    int key;
+    bool down;
+};
+
+//runs ticks of 1/TICK_RATE seconds up to the time of the latest frame, carrying what's left over into the next one
+//key events are queued with the time they happened and each tick takes the ones that happened during it,
+//so a tap shorter than a frame still counts and presses land on the tick they were made in
+struct ticker {
+    //time the ticks have been run up to and the time of the latest frame
+    double time;
+    double now;
+    //keys held down as of the last tick
+    struct presses pressed;
+    //key events no tick has taken yet, oldest first, in a ring buffer starting at first
+    struct key_event events[TICKER_EVENTS];
+    int first;
+    int count;
+};
+
+//handling and rules that can be tuned per game. initGame fills them in from the defines above
+struct settings {
+    double das;
+    double arr;
+    double lock_delay;
+    double sdrop_gravity;
+    double gravity_base;
+    double gravity_step;
+    int scoring[4];
+    //20G: pieces fall straight to the stack at every level, the moment they spawn or move
+    bool instant_gravity;
+};
+
+struct game_data {
+    struct settings settings;
+    int level;
+    int score;
+    int lines;
+    int pieces;
+    //seconds of play, advanced by gameStep
+    double time;
+    struct tetromino current;
+    //piece types still to come, a ring buffer starting at upcoming_start
+    uint8_t upcoming[UPCOMING_SIZE];
+    int upcoming_start;
+    int upcoming_count;
+    //state of the piece generator, so each game can be replayed from its seed
+    uint64_t random;
+    //how many pieces have been taken from the queue
+    int drawn;
+    //zobrist hash of the matrix, current and held piece types, whether hold has been used and the queue position
+    //kept up to date as pieces lock, lines clear and pieces are held
+    uint64_t hash;
+    struct board matrix;
+    //goes up every time the matrix changes, so drawing can tell when it needs redrawing
+    int board_version;
+    //rows per tick of gravity at each level, worked out from the settings by applySettings so steps don't have to
+    //a level whose pieces fall straight to the stack has BOARD_HEIGHT
+    double gravity[GRAVITY_LEVELS];
+    double sdrop_rows;
+    //rows gravity has built up that the piece hasn't fallen yet, always less than one after a step
+    double fallen;
+    double right_das;
+    double left_das;
+    double last_das_move;
+    bool locking;
+    double started_locking;
+    struct tetromino hold_piece;
+    bool holding;
+    bool has_been_held;
+    //rows cleared by the last piece to lock, bottom first
+    int cleared_rows[4];
+    int cleared_count;
+    //set once the game has been lost
+    bool over;
+};
+
+//indexes into names, SHAPES and KICKS
+enum pieces {
+    PIECE_I,
+    PIECE_T,
+    PIECE_Z,
+    PIECE_S,
+    PIECE_L,
+    PIECE_J,
+    PIECE_O
+};
+
+struct offset {
+    int8_t x;
+    int8_t y;
+};
+
+struct piece_shape {
+    //row 0 is the top of the 4x4 box, bit j of a row is column j
+    uint16_t rows[4];
+    //x and y of each block in the box, y counting down like rows
+    struct offset cells[4];
+    //y of the lowest block in each column of the box, -1 for a column with none
+    int8_t bottoms[4];
+};
+
+extern const char names[7];
+extern const struct settings default_settings;
+extern const struct piece_shape SHAPES[7][4];
+extern const struct offset KICKS[2][4][3][KICK_TESTS];
+extern const uint64_t ZOBRIST_CELLS[BOARD_HEIGHT][BOARD_WIDTH];
+extern const uint64_t ZOBRIST_CURRENT[7];
+extern const uint64_t ZOBRIST_HOLD[7];
+extern const uint64_t ZOBRIST_HELD;
+extern const uint64_t ZOBRIST_QUEUE[ZOBRIST_QUEUE_SIZE];
+
+uint32_t placeRow(uint16_t row, int x);
+//works out every column's height from the rows, for boards whose rows were set by hand
+void updateHeights(struct board *matrix);
+bool collides(struct board *matrix, int type, int rotation, int x, int y);
+void emptyMatrix(struct board *matrix);
+int getDroppedPos(struct board *matrix, struct tetromino piece);
+int getDASsedPos(struct board *matrix, struct tetromino piece, int direction);
+uint32_t nextRandom(uint64_t *state);
+void extendUpcoming(struct game_data *data);
+//type of the ith piece after the current one
+int upcomingPiece(struct game_data *data, int i);
+struct tetromino spawnPiece(int type);
+bool newCurrent(struct game_data *data);
+//hash of the filled cells of row y
+uint64_t rowHash(int y, uint16_t row);
+//hash of the rows from bottom up to the first empty one
+uint64_t stackHash(const uint16_t rows[BOARD_HEIGHT], int bottom);
+//hash of everything but the matrix, with -1 for no current or held piece
+uint64_t stateHash(int current, int hold, int drawn, bool has_been_held);
+//works out data->hash from scratch
+uint64_t gameHash(struct game_data *data);
+bool rotatePiece(struct board *matrix, struct tetromino *piece, int amount);
+int clearLines(struct board *matrix, int bottom, int top, int cleared[4]);
+bool lockPiece(struct game_data *data);
+//swaps the current piece with the held one, or stores it and takes the next if nothing is held yet
+bool holdPiece(struct game_data *data);
+//locks the current piece at the given position straight away, for bots that have already worked out where it goes
+bool placePiece(struct game_data *data, int rotation, int x, int y);
+
+void initGame(struct game_data *data, uint64_t seed);
+//sets the game's settings and works out its gravity table from them, for changing the settings initGame filled in
+void applySettings(struct game_data *data, struct settings settings);
+//advances the game by dt seconds with the given inputs, returns false once the game is over
+bool gameStep(struct game_data *data, struct inputs inputs, double dt);
+
+//the field of presses for key, NULL if key isn't one of enum keys
+bool *pressesKey(struct presses *presses, int key);
+
+//starts the ticks at now with nothing held down
+void initTicker(struct ticker *ticker, double now);
+//queues a key going down or up, returns false if the key isn't one of enum keys. nothing is dropped when the queue
+//is full, the oldest event is applied early to make room
+bool tickerPush(struct ticker *ticker, struct key_event event);
+//lets the ticks run up to now, or up to TICKER_MAX_CATCH_UP behind it if they've fallen further behind than that
+void tickerAdvance(struct ticker *ticker, double now);
+//returns true while there's a whole tick left before now, setting inputs to the keys held through it and pressed during it
+bool tickerNext(struct ticker *ticker, struct inputs *inputs);
+
+#endif
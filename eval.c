@@ -0,0 +1,290 @@
+#include <stdlib.h>
+#include "eval.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EVAL_X86
+#endif
+
+//neighbouring column pairs, the low column of each pair
+#define PAIR_MASK 0x0FF8
+//every cell boundary along a row, including the walls either side of the field
+#define EDGE_MASK 0x1FFC
+
+const struct eval_weights default_weights = {-4, -6, -80, -8, -30, -90, -30, {0, -40, -20, 40, 300}};
+
+const char *eval_kernel_names[EVAL_KERNELS] = {"scalar", "sse2", "avx2"};
+
+void boardFeatures(const uint16_t rows[BOARD_HEIGHT], struct eval_features *features) {
+    int heights[BOARD_WIDTH] = {0};
+    uint16_t covered = 0;
+    int holes = 0;
+    int wells = 0;
+    int max_height = 0;
+    int y, x;
+    for (y = BOARD_HEIGHT - 1; y >= 0; y--) {
+        uint16_t row = rows[y];
+        if (row == EMPTY_ROW && covered == 0) {
+            continue;
+        }
+        if (max_height == 0) {
+            max_height = y + 1;
+        }
+        holes = holes + __builtin_popcount(~row & covered & FIELD_MASK);
+        wells = wells + __builtin_popcount(~row & ~covered & (row << 1) & (row >> 1) & FIELD_MASK);
+        uint16_t tops = row & ~covered & FIELD_MASK;
+        while (tops) {
+            x = __builtin_ctz(tops);
+            tops &= tops - 1;
+            heights[x - WALL_OFFSET] = y + 1;
+        }
+        covered |= row;
+    }
+
+    int row_transitions = 0;
+    int column_transitions = 0;
+    uint16_t below = FULL_ROW;
+    for (y = 0; y < max_height; y++) {
+        row_transitions = row_transitions + __builtin_popcount((rows[y] ^ (rows[y] >> 1)) & 0x1FFC);
+        column_transitions = column_transitions + __builtin_popcount((rows[y] ^ below) & FIELD_MASK);
+        below = rows[y];
+    }
+    //the surface of the stack is a change from filled to empty as well
+    column_transitions = column_transitions + __builtin_popcount(below & FIELD_MASK);
+
+    int height = 0;
+    int bumpiness = 0;
+    for (x = 0; x < BOARD_WIDTH; x++) {
+        height = height + heights[x];
+        if (x > 0) {
+            bumpiness = bumpiness + abs(heights[x] - heights[x - 1]);
+        }
+    }
+
+    features->height = height;
+    features->max_height = max_height;
+    features->holes = holes;
+    features->bumpiness = bumpiness;
+    features->row_transitions = row_transitions;
+    features->column_transitions = column_transitions;
+    features->wells = wells;
+}
+
+//the batch kernels go through the rows top down and work out every feature with plain bit operations on each board
+//so lots of boards can go through at once, one per 16 bit lane. with covered being the columns filled at or above a row
+//the height of a column is the number of rows it's covered in, and the bumpiness between two columns is the number
+//of rows only one of them is covered in
+
+bool evalKernelSupported(enum eval_kernels kernel) {
+    switch (kernel) {
+        case EVAL_SCALAR:
+            return true;
+#ifdef EVAL_X86
+        case EVAL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case EVAL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+enum eval_kernels bestEvalKernel(void) {
+    int kernel;
+    for (kernel = EVAL_KERNELS - 1; kernel > EVAL_SCALAR; kernel--) {
+        if (evalKernelSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return EVAL_SCALAR;
+}
+
+void scalarFeatures(const uint16_t *boards[], int count, struct eval_features features[]) {
+    int i;
+    for (i = 0; i < count; i++) {
+        boardFeatures(boards[i], &features[i]);
+    }
+}
+
+#ifdef EVAL_X86
+
+//the boards of one batch laid out row by row, so a row of every board loads in one go
+struct lanes {
+    uint16_t rows[BOARD_HEIGHT][16] __attribute__((aligned(32)));
+};
+
+//fills lanes from the next width boards, padding with empty boards past count
+void fillLanes(struct lanes *lanes, const uint16_t *boards[], int count, int width) {
+    int i, y;
+    for (i = 0; i < width; i++) {
+        for (y = 0; y < BOARD_HEIGHT; y++) {
+            lanes->rows[y][i] = i < count ? boards[i][y] : EMPTY_ROW;
+        }
+    }
+}
+
+//the per lane totals a kernel leaves behind, in the order of struct eval_features
+struct lane_totals {
+    uint16_t totals[7][16] __attribute__((aligned(32)));
+};
+
+void storeFeatures(const struct lane_totals *totals, int count, struct eval_features features[]) {
+    int i;
+    for (i = 0; i < count; i++) {
+        features[i].height = totals->totals[0][i];
+        features[i].max_height = totals->totals[1][i];
+        features[i].holes = totals->totals[2][i];
+        features[i].bumpiness = totals->totals[3][i];
+        features[i].row_transitions = totals->totals[4][i];
+        features[i].column_transitions = totals->totals[5][i];
+        features[i].wells = totals->totals[6][i];
+    }
+}
+
+__attribute__((target("sse2")))
+__m128i popcount128(__m128i x) {
+    x = _mm_sub_epi16(x, _mm_and_si128(_mm_srli_epi16(x, 1), _mm_set1_epi16(0x5555)));
+    x = _mm_add_epi16(_mm_and_si128(x, _mm_set1_epi16(0x3333)), _mm_and_si128(_mm_srli_epi16(x, 2), _mm_set1_epi16(0x3333)));
+    x = _mm_and_si128(_mm_add_epi16(x, _mm_srli_epi16(x, 4)), _mm_set1_epi16(0x0F0F));
+    return _mm_and_si128(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), _mm_set1_epi16(0x1F));
+}
+
+__attribute__((target("sse2")))
+void sse2Features(const uint16_t *boards[], int count, struct eval_features features[]) {
+    const __m128i field = _mm_set1_epi16(FIELD_MASK);
+    const __m128i pairs = _mm_set1_epi16(PAIR_MASK);
+    const __m128i edges = _mm_set1_epi16(EDGE_MASK);
+    const __m128i zero = _mm_setzero_si128();
+    struct lanes lanes;
+    struct lane_totals totals;
+    int start, y;
+    for (start = 0; start < count; start = start + 8) {
+        int batch = count - start < 8 ? count - start : 8;
+        fillLanes(&lanes, &boards[start], batch, 8);
+        __m128i height = zero, max_height = zero, holes = zero, bumpiness = zero;
+        __m128i row_transitions = zero, column_transitions = zero, wells = zero;
+        __m128i covered = zero;
+        __m128i above = _mm_set1_epi16(EMPTY_ROW);
+        for (y = BOARD_HEIGHT - 1; y >= 0; y--) {
+            __m128i row = _mm_load_si128((const __m128i *) lanes.rows[y]);
+            __m128i open = _mm_andnot_si128(row, field);
+            holes = _mm_add_epi16(holes, popcount128(_mm_and_si128(open, covered)));
+            __m128i walled = _mm_and_si128(_mm_slli_epi16(row, 1), _mm_srli_epi16(row, 1));
+            wells = _mm_add_epi16(wells, popcount128(_mm_andnot_si128(covered, _mm_and_si128(open, walled))));
+            column_transitions = _mm_add_epi16(column_transitions, popcount128(_mm_and_si128(_mm_xor_si128(row, above), field)));
+            above = row;
+
+            covered = _mm_or_si128(covered, row);
+            __m128i columns = _mm_and_si128(covered, field);
+            height = _mm_add_epi16(height, popcount128(columns));
+            bumpiness = _mm_add_epi16(bumpiness, popcount128(_mm_and_si128(_mm_xor_si128(covered, _mm_srli_epi16(covered, 1)), pairs)));
+            //all ones in lanes that have reached the stack
+            __m128i stacked = _mm_xor_si128(_mm_cmpeq_epi16(columns, zero), _mm_set1_epi16(-1));
+            max_height = _mm_sub_epi16(max_height, stacked);
+            __m128i edge_changes = popcount128(_mm_and_si128(_mm_xor_si128(row, _mm_srli_epi16(row, 1)), edges));
+            row_transitions = _mm_add_epi16(row_transitions, _mm_and_si128(edge_changes, stacked));
+        }
+        //the floor counts as filled
+        column_transitions = _mm_add_epi16(column_transitions, popcount128(_mm_andnot_si128(above, field)));
+
+        _mm_store_si128((__m128i *) totals.totals[0], height);
+        _mm_store_si128((__m128i *) totals.totals[1], max_height);
+        _mm_store_si128((__m128i *) totals.totals[2], holes);
+        _mm_store_si128((__m128i *) totals.totals[3], bumpiness);
+        _mm_store_si128((__m128i *) totals.totals[4], row_transitions);
+        _mm_store_si128((__m128i *) totals.totals[5], column_transitions);
+        _mm_store_si128((__m128i *) totals.totals[6], wells);
+        storeFeatures(&totals, batch, &features[start]);
+    }
+}
+
+__attribute__((target("avx2")))
+__m256i popcount256(__m256i x) {
+    //looks up the count of each nibble then adds the two bytes of each lane
+    const __m256i counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(counts, _mm256_and_si256(x, nibble)),
+                                    _mm256_shuffle_epi8(counts, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble)));
+    return _mm256_and_si256(_mm256_add_epi16(bytes, _mm256_srli_epi16(bytes, 8)), _mm256_set1_epi16(0x1F));
+}
+
+__attribute__((target("avx2")))
+void avx2Features(const uint16_t *boards[], int count, struct eval_features features[]) {
+    const __m256i field = _mm256_set1_epi16(FIELD_MASK);
+    const __m256i pairs = _mm256_set1_epi16(PAIR_MASK);
+    const __m256i edges = _mm256_set1_epi16(EDGE_MASK);
+    const __m256i zero = _mm256_setzero_si256();
+    struct lanes lanes;
+    struct lane_totals totals;
+    int start, y;
+    for (start = 0; start < count; start = start + 16) {
+        int batch = count - start < 16 ? count - start : 16;
+        fillLanes(&lanes, &boards[start], batch, 16);
+        __m256i height = zero, max_height = zero, holes = zero, bumpiness = zero;
+        __m256i row_transitions = zero, column_transitions = zero, wells = zero;
+        __m256i covered = zero;
+        __m256i above = _mm256_set1_epi16(EMPTY_ROW);
+        for (y = BOARD_HEIGHT - 1; y >= 0; y--) {
+            __m256i row = _mm256_load_si256((const __m256i *) lanes.rows[y]);
+            __m256i open = _mm256_andnot_si256(row, field);
+            holes = _mm256_add_epi16(holes, popcount256(_mm256_and_si256(open, covered)));
+            __m256i walled = _mm256_and_si256(_mm256_slli_epi16(row, 1), _mm256_srli_epi16(row, 1));
+            wells = _mm256_add_epi16(wells, popcount256(_mm256_andnot_si256(covered, _mm256_and_si256(open, walled))));
+            column_transitions = _mm256_add_epi16(column_transitions, popcount256(_mm256_and_si256(_mm256_xor_si256(row, above), field)));
+            above = row;
+
+            covered = _mm256_or_si256(covered, row);
+            __m256i columns = _mm256_and_si256(covered, field);
+            height = _mm256_add_epi16(height, popcount256(columns));
+            bumpiness = _mm256_add_epi16(bumpiness, popcount256(_mm256_and_si256(_mm256_xor_si256(covered, _mm256_srli_epi16(covered, 1)), pairs)));
+            __m256i stacked = _mm256_xor_si256(_mm256_cmpeq_epi16(columns, zero), _mm256_set1_epi16(-1));
+            max_height = _mm256_sub_epi16(max_height, stacked);
+            __m256i edge_changes = popcount256(_mm256_and_si256(_mm256_xor_si256(row, _mm256_srli_epi16(row, 1)), edges));
+            row_transitions = _mm256_add_epi16(row_transitions, _mm256_and_si256(edge_changes, stacked));
+        }
+        column_transitions = _mm256_add_epi16(column_transitions, popcount256(_mm256_andnot_si256(above, field)));
+
+        _mm256_store_si256((__m256i *) totals.totals[0], height);
+        _mm256_store_si256((__m256i *) totals.totals[1], max_height);
+        _mm256_store_si256((__m256i *) totals.totals[2], holes);
+        _mm256_store_si256((__m256i *) totals.totals[3], bumpiness);
+        _mm256_store_si256((__m256i *) totals.totals[4], row_transitions);
+        _mm256_store_si256((__m256i *) totals.totals[5], column_transitions);
+        _mm256_store_si256((__m256i *) totals.totals[6], wells);
+        storeFeatures(&totals, batch, &features[start]);
+    }
+}
+
+#endif
+
+void batchFeaturesWith(enum eval_kernels kernel, const uint16_t *boards[], int count, struct eval_features features[]) {
+    switch (kernel) {
+#ifdef EVAL_X86
+        case EVAL_SSE2:
+            sse2Features(boards, count, features);
+            break;
+        case EVAL_AVX2:
+            avx2Features(boards, count, features);
+            break;
+#endif
+        default:
+            scalarFeatures(boards, count, features);
+            break;
+    }
+}
+
+void batchFeatures(const uint16_t *boards[], int count, struct eval_features features[]) {
+    batchFeaturesWith(bestEvalKernel(), boards, count, features);
+}
+
+int evaluateFeatures(const struct eval_features *features, const struct eval_weights *weights) {
+    return weights->height * features->height
+         + weights->max_height * features->max_height
+         + weights->holes * features->holes
+         + weights->bumpiness * features->bumpiness
+         + weights->row_transitions * features->row_transitions
+         + weights->column_transitions * features->column_transitions
+         + weights->wells * features->wells;
+}
@@ -0,0 +1,54 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "engine.h"
+
+//things about a board that make it better or worse to play on
+struct eval_features {
+    //sum of the column heights
+    int height;
+    int max_height;
+    //empty cells with something above them
+    int holes;
+    //sum of the height differences between neighbouring columns
+    int bumpiness;
+    //filled to empty changes along the rows, counting the walls as filled
+    int row_transitions;
+    //filled to empty changes up the columns, counting the floor as filled
+    int column_transitions;
+    //open cells with filled cells or walls either side, so a well 3 deep counts 3
+    int wells;
+};
+
+//how much each feature is worth, usually negative, plus a reward for clearing 0 to 4 lines
+struct eval_weights {
+    int height;
+    int max_height;
+    int holes;
+    int bumpiness;
+    int row_transitions;
+    int column_transitions;
+    int wells;
+    int clears[5];
+};
+
+extern const struct eval_weights default_weights;
+
+//ways of working out features for a batch of boards, each one after the first scores more boards at once
+enum eval_kernels {EVAL_SCALAR, EVAL_SSE2, EVAL_AVX2, EVAL_KERNELS};
+
+extern const char *eval_kernel_names[EVAL_KERNELS];
+
+//the straightforward version, which the batch kernels are checked against
+void boardFeatures(const uint16_t rows[BOARD_HEIGHT], struct eval_features *features);
+//whether this cpu can run kernel
+bool evalKernelSupported(enum eval_kernels kernel);
+//the fastest kernel this cpu can run
+enum eval_kernels bestEvalKernel(void);
+//works out the features of count boards with the given kernel, which has to be supported
+void batchFeaturesWith(enum eval_kernels kernel, const uint16_t *boards[], int count, struct eval_features features[]);
+//works out the features of count boards with the fastest kernel
+void batchFeatures(const uint16_t *boards[], int count, struct eval_features features[]);
+int evaluateFeatures(const struct eval_features *features, const struct eval_weights *weights);
+
+#endif
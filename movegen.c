@@ -0,0 +1,165 @@
+#include "movegen.h"
+
+//the search works on whole rows at once. for each rotation and row there is a 16 bit mask where bit x + WALL_OFFSET
+//means the piece at that x, which is the same layout the board rows use, so every column is tried in a few operations
+
+struct canonical {
+    int8_t rotation;
+    int8_t x;
+    int8_t y;
+};
+
+//a piece in rotation r at (x, y) covers the same blocks as CANONICAL[type][r].rotation at (x + .x, y + .y)
+const struct canonical CANONICAL[7][4] = {
+    {{0, 0, 0}, {1, 0, 0}, {0, 0, -1}, {1, -1, 0}},
+    {{0, 0, 0}, {1, 0, 0}, {2, 0, 0}, {3, 0, 0}},
+    {{0, 0, 0}, {1, 0, 0}, {0, 0, -1}, {1, -1, 0}},
+    {{0, 0, 0}, {1, 0, 0}, {0, 0, -1}, {1, -1, 0}},
+    {{0, 0, 0}, {1, 0, 0}, {2, 0, 0}, {3, 0, 0}},
+    {{0, 0, 0}, {1, 0, 0}, {2, 0, 0}, {3, 0, 0}},
+    {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}}
+};
+
+//every x the piece fits at in row y, as a mask
+uint16_t fitsAt(const uint16_t board[BOARD_HEIGHT], const uint16_t rows[4], int y) {
+    uint32_t blocked = 0;
+    int i, j;
+    for (i = 0; i < 4; i++) {
+        if (rows[i]) {
+            if (y - i < 0 || y - i >= BOARD_HEIGHT) {
+                return 0;
+            }
+            //anything past bit 15 is the right wall
+            uint32_t row = board[y - i] | 0xFFFF0000u;
+            for (j = 0; j < 4; j++) {
+                if (rows[i] & (1 << j)) {
+                    blocked |= row >> j;
+                }
+            }
+        }
+    }
+    return ~blocked;
+}
+
+uint16_t shiftMask(uint16_t mask, int x) {
+    return x >= 0 ? mask << x : mask >> -x;
+}
+
+int findPlacements(const uint16_t board[BOARD_HEIGHT], struct tetromino piece, struct placement placements[], int max) {
+    uint16_t fits[4][BOARD_HEIGHT];
+    uint16_t reach[4][BOARD_HEIGHT] = {{0}};
+    int rotations = piece.type == PIECE_O ? 1 : 4;
+    int r, y;
+    //the O looks the same every way round so searching one rotation of it is enough
+    if (piece.type == PIECE_O) {
+        piece.rotation = 0;
+    }
+    if (piece.y < 0 || piece.y >= BOARD_HEIGHT || !(fitsAt(board, SHAPES[piece.type][piece.rotation].rows, piece.y) & (1 << (piece.x + WALL_OFFSET)))) {
+        return 0;
+    }
+
+    //from open upwards every rotation is clear of the stack, so a piece up there can turn and shift to anywhere
+    //the walls allow and then drop straight to open. the search only has to start from that row
+    int top = BOARD_HEIGHT - 1;
+    while (top >= 0 && board[top] == EMPTY_ROW) {
+        top = top - 1;
+    }
+    int open = top + 4;
+    if (piece.y < open || open >= BOARD_HEIGHT) {
+        open = BOARD_HEIGHT - 1;
+    }
+
+    for (r = 0; r < rotations; r++) {
+        for (y = 0; y <= open; y++) {
+            fits[r][y] = fitsAt(board, SHAPES[piece.type][r].rows, y);
+        }
+    }
+    if (open == BOARD_HEIGHT - 1) {
+        reach[piece.rotation][piece.y] = 1 << (piece.x + WALL_OFFSET);
+    } else {
+        for (r = 0; r < rotations; r++) {
+            reach[r][open] = fits[r][open];
+        }
+    }
+
+    //sweep down the board spreading what is reachable until a sweep finds nothing new
+    //moving down is handled within a sweep, only kicks upwards or into earlier rotations need another
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (y = open; y >= 0; y--) {
+            for (r = 0; r < rotations; r++) {
+                uint16_t mask = reach[r][y];
+                if (!mask) {
+                    continue;
+                }
+                uint16_t previous;
+                do {
+                    previous = mask;
+                    mask |= ((mask << 1) | (mask >> 1)) & fits[r][y];
+                } while (mask != previous);
+                reach[r][y] = mask;
+
+                if (y > 0) {
+                    reach[r][y - 1] |= mask & fits[r][y - 1];
+                }
+
+                int amount;
+                for (amount = 1; amount < rotations; amount++) {
+                    int to = (r + amount) % 4;
+                    const struct offset *kicks = KICKS[piece.type == PIECE_I][r][amount - 1];
+                    //each position only gets the first kick that works for it, like rotatePiece
+                    uint16_t remaining = mask;
+                    int i;
+                    for (i = 0; i < KICK_TESTS && remaining; i++) {
+                        int to_y = y + kicks[i].y;
+                        if (to_y < 0 || to_y >= BOARD_HEIGHT) {
+                            continue;
+                        }
+                        //rows above open are as clear as open itself, and everything up there is already covered
+                        uint16_t kicked = remaining & shiftMask(fits[to][to_y > open ? open : to_y], -kicks[i].x);
+                        remaining &= ~kicked;
+                        if (to_y > open) {
+                            continue;
+                        }
+                        uint16_t added = shiftMask(kicked, kicks[i].x) & ~reach[to][to_y];
+                        if (added) {
+                            reach[to][to_y] |= added;
+                            if (to_y > y || (to_y == y && to < r)) {
+                                changed = true;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    //a reachable position locks if it can't move down, then symmetric rotations are folded onto their canonical one
+    uint16_t locks[4][BOARD_HEIGHT] = {{0}};
+    for (r = 0; r < rotations; r++) {
+        const struct canonical *canonical = &CANONICAL[piece.type][r];
+        for (y = 0; y <= open; y++) {
+            uint16_t lock = reach[r][y] & ~(y > 0 ? fits[r][y - 1] : 0);
+            if (lock) {
+                locks[canonical->rotation][y + canonical->y] |= shiftMask(lock, canonical->x);
+            }
+        }
+    }
+
+    int count = 0;
+    for (r = 0; r < rotations; r++) {
+        for (y = 0; y <= open; y++) {
+            uint16_t lock = locks[r][y];
+            while (lock) {
+                int bit = __builtin_ctz(lock);
+                lock &= lock - 1;
+                if (count < max) {
+                    placements[count] = (struct placement) {r, bit - WALL_OFFSET, y};
+                }
+                count = count + 1;
+            }
+        }
+    }
+    return count < max ? count : max;
+}
@@ -0,0 +1,20 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include "engine.h"
+
+//enough for every rotation, column and row, so findPlacements can never run out of room
+#define MAX_PLACEMENTS (4 * 16 * BOARD_HEIGHT)
+
+//somewhere a piece can lock. pieces that look the same in two rotations only get the lowest one
+struct placement {
+    int8_t rotation;
+    int8_t x;
+    int8_t y;
+};
+
+//finds every distinct position the piece can lock in from where it is now, by shifting, rotating with kicks and soft dropping
+//board is the rows of a struct board. writes up to max of them to placements and returns how many it wrote
+int findPlacements(const uint16_t board[BOARD_HEIGHT], struct tetromino piece, struct placement placements[], int max);
+
+#endif
@@ -0,0 +1,242 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "packed.h"
+
+//writes packed_assets.c for the game: the images scaled to the size they're drawn at and the glyphs of both fonts,
+//shelf packed into one atlas. run by make whenever an image or the font changes
+
+//gap left around everything so filtering never picks up a neighbour
+#define PADDING 1
+
+const char *image_paths[PACKED_IMAGES] = {"logo.png", "play button.png", "end screen.png"};
+const int image_sizes[PACKED_IMAGES][2] = {{LOGO_WIDTH, LOGO_HEIGHT}, {PLAY_BUTTON_WIDTH, PLAY_BUTTON_HEIGHT}, {END_WIDTH, END_HEIGHT}};
+const int font_sizes[PACKED_FONTS] = {FONT_SIZE, SMALL_FONT_SIZE};
+const char *font_path = "Roboto-Regular.ttf";
+
+//RGBA bytes, one row after another
+struct image {
+    int w;
+    int h;
+    uint8_t *pixels;
+};
+
+//everything going into the atlas, the images first and then each font's glyphs
+#define SPRITES (PACKED_IMAGES + PACKED_FONTS * GLYPH_COUNT)
+
+struct sprite {
+    struct image image;
+    struct packed_rect rect;
+};
+
+//copies surface out as RGBA, freeing it. returns false if it couldn't be converted
+bool surfaceImage(SDL_Surface *surface, struct image *image) {
+    SDL_Surface *converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(surface);
+    if (converted == NULL) {
+        return false;
+    }
+    image->w = converted->w;
+    image->h = converted->h;
+    image->pixels = malloc((size_t) image->w * image->h * 4);
+    int y;
+    for (y = 0; y < image->h; y++) {
+        memcpy(image->pixels + (size_t) y * image->w * 4, (uint8_t *) converted->pixels + (size_t) y * converted->pitch, image->w * 4);
+    }
+    SDL_FreeSurface(converted);
+    return true;
+}
+
+//averages every pixel of source under each pixel of a w by h image, weighting by alpha so edges don't darken
+struct image scaleImage(struct image source, int w, int h) {
+    struct image scaled = {w, h, malloc((size_t) w * h * 4)};
+    int x, y, i, j, c;
+    for (y = 0; y < h; y++) {
+        int top = y * source.h / h;
+        int bottom = ((y + 1) * source.h + h - 1) / h;
+        for (x = 0; x < w; x++) {
+            int left = x * source.w / w;
+            int right = ((x + 1) * source.w + w - 1) / w;
+            double sums[4] = {0, 0, 0, 0};
+            int count = 0;
+            for (i = top; i < bottom; i++) {
+                for (j = left; j < right; j++) {
+                    const uint8_t *pixel = source.pixels + ((size_t) i * source.w + j) * 4;
+                    for (c = 0; c < 3; c++) {
+                        sums[c] = sums[c] + pixel[c] * pixel[3];
+                    }
+                    sums[3] = sums[3] + pixel[3];
+                    count = count + 1;
+                }
+            }
+            uint8_t *out = scaled.pixels + ((size_t) y * w + x) * 4;
+            for (c = 0; c < 3; c++) {
+                out[c] = sums[3] > 0 ? sums[c] / sums[3] + 0.5 : 0;
+            }
+            out[3] = count > 0 ? sums[3] / count + 0.5 : 0;
+        }
+    }
+    return scaled;
+}
+
+//places the sprites in rows from the tallest down, returns the height of the atlas
+int packSprites(struct sprite sprites[SPRITES]) {
+    int order[SPRITES];
+    int i, j;
+    for (i = 0; i < SPRITES; i++) {
+        order[i] = i;
+    }
+    //insertion sort by height, there's only a couple of hundred
+    for (i = 1; i < SPRITES; i++) {
+        int sprite = order[i];
+        for (j = i; j > 0 && sprites[order[j - 1]].image.h < sprites[sprite].image.h; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = sprite;
+    }
+
+    int x = 0;
+    int y = 0;
+    int row_height = 0;
+    for (i = 0; i < SPRITES; i++) {
+        struct sprite *sprite = &sprites[order[i]];
+        if (sprite->image.w == 0 || sprite->image.h == 0) {
+            sprite->rect = (struct packed_rect) {0, 0, 0, 0};
+            continue;
+        }
+        if (x + sprite->image.w + PADDING > PACKED_WIDTH) {
+            x = 0;
+            y = y + row_height;
+            row_height = 0;
+        }
+        sprite->rect = (struct packed_rect) {x + PADDING, y + PADDING, sprite->image.w, sprite->image.h};
+        x = x + sprite->image.w + PADDING;
+        row_height = row_height > sprite->image.h + PADDING ? row_height : sprite->image.h + PADDING;
+    }
+    return y + row_height + PADDING;
+}
+
+void writeRect(FILE *file, struct packed_rect rect) {
+    fprintf(file, "{%d, %d, %d, %d}", rect.x, rect.y, rect.w, rect.h);
+}
+
+bool writePacked(const char *path, struct sprite sprites[SPRITES], int advances[PACKED_FONTS][GLYPH_COUNT], int height) {
+    uint8_t *pixels = calloc((size_t) PACKED_WIDTH * height, 4);
+    int i, y;
+    for (i = 0; i < SPRITES; i++) {
+        struct packed_rect rect = sprites[i].rect;
+        for (y = 0; y < rect.h; y++) {
+            memcpy(pixels + ((size_t) (rect.y + y) * PACKED_WIDTH + rect.x) * 4, sprites[i].image.pixels + (size_t) y * rect.w * 4, rect.w * 4);
+        }
+    }
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        free(pixels);
+        return false;
+    }
+    fprintf(file, "//written by tetris-pack, don't edit\n#include \"packed.h\"\n\n");
+    fprintf(file, "const int packed_height = %d;\n\n", height);
+    fprintf(file, "const struct packed_rect packed_images[PACKED_IMAGES] = {\n");
+    for (i = 0; i < PACKED_IMAGES; i++) {
+        fprintf(file, "    ");
+        writeRect(file, sprites[i].rect);
+        fprintf(file, ",\n");
+    }
+    fprintf(file, "};\n\nconst struct packed_font packed_fonts[PACKED_FONTS] = {\n");
+    int font, glyph;
+    for (font = 0; font < PACKED_FONTS; font++) {
+        fprintf(file, "    {\n        {");
+        for (glyph = 0; glyph < GLYPH_COUNT; glyph++) {
+            writeRect(file, sprites[PACKED_IMAGES + font * GLYPH_COUNT + glyph].rect);
+            fprintf(file, glyph % 8 == 7 ? ",\n         " : ", ");
+        }
+        fprintf(file, "},\n        {");
+        for (glyph = 0; glyph < GLYPH_COUNT; glyph++) {
+            fprintf(file, "%d, ", advances[font][glyph]);
+        }
+        fprintf(file, "},\n    },\n");
+    }
+    fprintf(file, "};\n\n");
+
+    //one string of escaped bytes, which compiles much faster than a list of numbers this long
+    size_t size = (size_t) PACKED_WIDTH * height * 4;
+    fprintf(file, "const uint8_t packed_pixels[%zu] =\n", size);
+    size_t byte;
+    for (byte = 0; byte < size; byte++) {
+        if (byte % 64 == 0) {
+            fprintf(file, "    \"");
+        }
+        fprintf(file, "\\x%02x", pixels[byte]);
+        if (byte % 64 == 63 || byte == size - 1) {
+            fprintf(file, "\"\n");
+        }
+    }
+    fprintf(file, "    ;\n");
+    free(pixels);
+    bool written = !ferror(file);
+    written = fclose(file) == 0 && written;
+    return written;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s output.c\n", argv[0]);
+        return 1;
+    }
+    if (TTF_Init() != 0) {
+        fprintf(stderr, "couldn't start SDL_ttf: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    static struct sprite sprites[SPRITES];
+    int advances[PACKED_FONTS][GLYPH_COUNT];
+    int i;
+    for (i = 0; i < PACKED_IMAGES; i++) {
+        struct image image;
+        SDL_Surface *surface = IMG_Load(image_paths[i]);
+        if (surface == NULL || !surfaceImage(surface, &image)) {
+            fprintf(stderr, "couldn't load %s: %s\n", image_paths[i], SDL_GetError());
+            return 1;
+        }
+        sprites[i].image = scaleImage(image, image_sizes[i][0], image_sizes[i][1]);
+        free(image.pixels);
+    }
+
+    int font, glyph;
+    for (font = 0; font < PACKED_FONTS; font++) {
+        TTF_Font *ttf = TTF_OpenFont(font_path, font_sizes[font]);
+        if (ttf == NULL) {
+            fprintf(stderr, "couldn't open %s: %s\n", font_path, SDL_GetError());
+            return 1;
+        }
+        for (glyph = 0; glyph < GLYPH_COUNT; glyph++) {
+            struct sprite *sprite = &sprites[PACKED_IMAGES + font * GLYPH_COUNT + glyph];
+            int min_x, max_x, min_y, max_y;
+            if (TTF_GlyphMetrics(ttf, GLYPH_FIRST + glyph, &min_x, &max_x, &min_y, &max_y, &advances[font][glyph]) != 0) {
+                advances[font][glyph] = 0;
+            }
+            SDL_Surface *surface = TTF_RenderGlyph_Blended(ttf, GLYPH_FIRST + glyph, (SDL_Colour) {255, 255, 255, 255});
+            if (surface == NULL || !surfaceImage(surface, &sprite->image)) {
+                sprite->image = (struct image) {0, 0, NULL};
+            }
+        }
+        TTF_CloseFont(ttf);
+    }
+    TTF_Quit();
+
+    int height = packSprites(sprites);
+    if (!writePacked(argv[1], sprites, advances, height)) {
+        fprintf(stderr, "couldn't write %s\n", argv[1]);
+        return 1;
+    }
+    for (i = 0; i < SPRITES; i++) {
+        free(sprites[i].image.pixels);
+    }
+    printf("packed %d images and %d glyphs into %dx%d\n", PACKED_IMAGES, PACKED_FONTS * GLYPH_COUNT, PACKED_WIDTH, height);
+    return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+//the images and fonts the game draws, packed by tetris-pack at build time into one RGBA32 atlas that's compiled into
+//the game, so starting up is a single texture upload with no files to find and nothing to decode
+
+#include <stdint.h>
+
+#define WINDOW_WIDTH 800
+#define WINDOW_HEIGHT 600
+
+//images are packed at the size they're drawn at, so they're copied to the screen 1:1
+#define LOGO_WIDTH (WINDOW_WIDTH/2)
+#define LOGO_HEIGHT (WINDOW_WIDTH/2*795/957)
+#define PLAY_BUTTON_WIDTH (WINDOW_WIDTH/3)
+#define PLAY_BUTTON_HEIGHT (WINDOW_WIDTH/3*766/1352)
+#define END_WIDTH WINDOW_WIDTH
+#define END_HEIGHT (1045*WINDOW_WIDTH/2048)
+
+#define FONT_SIZE (40*WINDOW_HEIGHT/600)
+#define SMALL_FONT_SIZE (14*WINDOW_HEIGHT/600)
+
+//fonts have a glyph for each printable ascii character, rendered in white so they can be drawn in any colour
+#define GLYPH_FIRST ' '
+#define GLYPH_COUNT 95
+
+#define PACKED_WIDTH 1024
+
+struct packed_rect {
+    int x;
+    int y;
+    int w;
+    int h;
+};
+
+struct packed_font {
+    //a glyph with no pixels, like space, has an empty rect
+    struct packed_rect glyphs[GLYPH_COUNT];
+    //how far along the next glyph starts
+    int advances[GLYPH_COUNT];
+};
+
+enum packed_images {
+    PACKED_LOGO,
+    PACKED_PLAY_BUTTON,
+    PACKED_END,
+    PACKED_IMAGES
+};
+
+enum packed_fonts {
+    PACKED_FONT,
+    PACKED_SMALL_FONT,
+    PACKED_FONTS
+};
+
+//in packed_assets.c, which tetris-pack writes
+extern const int packed_height;
+//PACKED_WIDTH by packed_height pixels, 4 bytes each in the order red, green, blue, alpha
+extern const uint8_t packed_pixels[];
+extern const struct packed_rect packed_images[PACKED_IMAGES];
+extern const struct packed_font packed_fonts[PACKED_FONTS];
+
+#endif
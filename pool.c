@@ -0,0 +1,129 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+//the indexes a worker still has to run, from next up to but not including end
+//the owner takes from the front and thieves take the back half
+struct queue {
+    pthread_mutex_t lock;
+    int next;
+    int end;
+};
+
+struct pool {
+    struct queue *queues;
+    int threads;
+    void (*job)(void *context, int index, int worker);
+    void *context;
+};
+
+struct worker {
+    struct pool *pool;
+    int id;
+};
+
+//up to this many threads are run without touching the heap, since the bot calls poolRun for every depth of every search
+#define POOL_STACK_THREADS 64
+
+bool takeJob(struct queue *queue, int *index) {
+    bool found = false;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->next < queue->end) {
+        *index = queue->next;
+        queue->next = queue->next + 1;
+        found = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+//moves the back half of the victim's jobs to the thief, returns false if there was nothing to take
+bool stealJobs(struct queue *thief, struct queue *victim) {
+    int next, end;
+    pthread_mutex_lock(&victim->lock);
+    int left = victim->end - victim->next;
+    if (left <= 0) {
+        pthread_mutex_unlock(&victim->lock);
+        return false;
+    }
+    end = victim->end;
+    next = end - (left + 1) / 2;
+    victim->end = next;
+    pthread_mutex_unlock(&victim->lock);
+
+    pthread_mutex_lock(&thief->lock);
+    thief->next = next;
+    thief->end = end;
+    pthread_mutex_unlock(&thief->lock);
+    return true;
+}
+
+void *workerRun(void *arg) {
+    struct worker *worker = arg;
+    struct pool *pool = worker->pool;
+    struct queue *own = &pool->queues[worker->id];
+    int index;
+    while (true) {
+        while (takeJob(own, &index)) {
+            pool->job(pool->context, index, worker->id);
+        }
+        //own queue is empty so look for the first other worker with something left
+        bool stolen = false;
+        int i;
+        for (i = 1; i < pool->threads && !stolen; i++) {
+            stolen = stealJobs(own, &pool->queues[(worker->id + i) % pool->threads]);
+        }
+        if (!stolen) {
+            return NULL;
+        }
+    }
+}
+
+void poolRun(int threads, int jobs, void (*job)(void *context, int index, int worker), void *context) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > jobs && jobs > 0) {
+        threads = jobs;
+    }
+    struct queue stack_queues[POOL_STACK_THREADS];
+    struct worker stack_workers[POOL_STACK_THREADS];
+    pthread_t stack_ids[POOL_STACK_THREADS];
+    bool heap = threads > POOL_STACK_THREADS;
+    struct pool pool = {heap ? malloc(sizeof(struct queue) * threads) : stack_queues, threads, job, context};
+    struct worker *workers = heap ? malloc(sizeof(struct worker) * threads) : stack_workers;
+    pthread_t *ids = heap ? malloc(sizeof(pthread_t) * threads) : stack_ids;
+
+    int i;
+    for (i = 0; i < threads; i++) {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].next = (long) jobs * i / threads;
+        pool.queues[i].end = (long) jobs * (i + 1) / threads;
+        workers[i] = (struct worker) {&pool, i};
+    }
+    //the calling thread works too, as worker 0
+    for (i = 1; i < threads; i++) {
+        pthread_create(&ids[i], NULL, workerRun, &workers[i]);
+    }
+    workerRun(&workers[0]);
+    for (i = 1; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    for (i = 0; i < threads; i++) {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+    if (heap) {
+        free(pool.queues);
+        free(workers);
+        free(ids);
+    }
+}
+
+int poolCores(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores < 1 ? 1 : cores;
+}
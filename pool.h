@@ -0,0 +1,12 @@
+#ifndef POOL_H
+#define POOL_H
+
+//runs job(context, index, worker) once for every index from 0 to jobs - 1 across threads workers
+//each worker starts with an even share of the indexes and steals from the others once its own run out
+//worker is between 0 and threads - 1 so jobs can keep per thread state. returns once every job is done
+void poolRun(int threads, int jobs, void (*job)(void *context, int index, int worker), void *context);
+
+//number of cores available, at least 1
+int poolCores(void);
+
+#endif
@@ -0,0 +1,335 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "replay.h"
+
+//presses as a bit mask, one bit per key in the order of struct presses
+uint32_t pressesMask(struct presses presses) {
+    bool keys[10] = {presses.rotc, presses.sdrop, presses.right, presses.left, presses.enter,
+                     presses.hdrop, presses.rota, presses.rot180, presses.hold, presses.quit};
+    uint32_t mask = 0;
+    int i;
+    for (i = 0; i < 10; i++) {
+        mask |= (uint32_t) keys[i] << i;
+    }
+    return mask;
+}
+
+struct presses maskPresses(uint32_t mask) {
+    struct presses presses = {mask & 1, mask >> 1 & 1, mask >> 2 & 1, mask >> 3 & 1, mask >> 4 & 1,
+                              mask >> 5 & 1, mask >> 6 & 1, mask >> 7 & 1, mask >> 8 & 1, mask >> 9 & 1};
+    return presses;
+}
+
+void writeVarint(struct recorder *recorder, uint64_t value) {
+    uint8_t bytes[10];
+    int count = 0;
+    while (value >= 0x80) {
+        bytes[count] = value | 0x80;
+        value = value >> 7;
+        count = count + 1;
+    }
+    bytes[count] = value;
+    count = count + 1;
+    fwrite(bytes, 1, count, recorder->file);
+    recorder->offset = recorder->offset + count;
+}
+
+//returns false if the varint runs past end
+bool readVarint(const uint8_t *bytes, size_t *position, size_t end, uint64_t *value) {
+    *value = 0;
+    int shift;
+    for (shift = 0; shift < 64 && *position < end; shift = shift + 7) {
+        uint8_t byte = bytes[*position];
+        *position = *position + 1;
+        *value |= (uint64_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void flushRun(struct recorder *recorder) {
+    if (recorder->run_count == 0) {
+        return;
+    }
+    if (recorder->run_count == 1) {
+        writeVarint(recorder, recorder->run_dt << 3);
+    } else {
+        writeVarint(recorder, recorder->run_dt << 3 | RECORD_REPEATS);
+        writeVarint(recorder, recorder->run_count - 1);
+    }
+    recorder->run_count = 0;
+}
+
+//starts recording into file, which has just been opened for writing
+bool beginRecording(struct recorder *recorder, FILE *file, struct game_data *data, uint64_t seed) {
+    recorder->file = file;
+    struct replay_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = REPLAY_MAGIC;
+    header.version = REPLAY_VERSION;
+    header.state_size = sizeof(struct game_data);
+    header.seed = seed;
+    header.started = time(NULL);
+    header.settings = data->settings;
+    fwrite(&header, sizeof(header), 1, recorder->file);
+    recorder->offset = sizeof(header);
+    recorder->steps = 0;
+    recorder->pressed = 0;
+    recorder->run_dt = 0;
+    recorder->run_count = 0;
+    recorder->next_keyframe = REPLAY_KEYFRAME_INTERVAL;
+    //all the room for keyframes is taken now, so recording never allocates while the game is being played
+    recorder->keyframes = malloc(sizeof(struct replay_keyframe) * REPLAY_MAX_KEYFRAMES);
+    recorder->keyframe_count = 0;
+    if (recorder->keyframes == NULL) {
+        recorder->next_keyframe = DBL_MAX;
+    }
+    return true;
+}
+
+bool startRecording(struct recorder *recorder, const char *path, struct game_data *data, uint64_t seed) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    return beginRecording(recorder, file, data, seed);
+}
+
+bool startNewRecording(struct recorder *recorder, const char *directory, struct game_data *data, uint64_t seed, char *path, size_t size) {
+    int attempt;
+    for (attempt = 1; attempt <= REPLAY_NAME_ATTEMPTS; attempt++) {
+        if (attempt == 1) {
+            snprintf(path, size, "%s/%llu.ttr", directory, (unsigned long long) seed);
+        } else {
+            snprintf(path, size, "%s/%llu-%d.ttr", directory, (unsigned long long) seed, attempt);
+        }
+        //created only if nothing's there, so two games, or two instances of the game, never write over each other
+        int file = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (file < 0) {
+            if (errno == EEXIST) {
+                continue;
+            }
+            return false;
+        }
+        FILE *stream = fdopen(file, "wb");
+        if (stream == NULL) {
+            close(file);
+            return false;
+        }
+        return beginRecording(recorder, stream, data, seed);
+    }
+    return false;
+}
+
+bool recordStep(struct recorder *recorder, struct game_data *data, struct inputs inputs, double dt) {
+    uint64_t dt_us = dt > 0 ? dt * 1e6 + 0.5 : 0;
+    uint32_t pressed = pressesMask(inputs.pressed);
+    uint32_t just_pressed = pressesMask(inputs.just_pressed);
+    int flags = (pressed != recorder->pressed ? RECORD_PRESSED : 0) | (just_pressed ? RECORD_JUST_PRESSED : 0);
+
+    if (flags == 0 && recorder->run_count > 0 && recorder->run_dt == dt_us) {
+        recorder->run_count = recorder->run_count + 1;
+    } else {
+        flushRun(recorder);
+        if (flags == 0) {
+            recorder->run_dt = dt_us;
+            recorder->run_count = 1;
+        } else {
+            writeVarint(recorder, dt_us << 3 | flags);
+            if (flags & RECORD_PRESSED) {
+                writeVarint(recorder, pressed);
+            }
+            if (flags & RECORD_JUST_PRESSED) {
+                writeVarint(recorder, just_pressed);
+            }
+        }
+    }
+    recorder->pressed = pressed;
+    recorder->steps = recorder->steps + 1;
+
+    //the replay steps with exactly what was recorded, so the game has to as well
+    bool playing = gameStep(data, (struct inputs) {maskPresses(pressed), maskPresses(just_pressed)}, dt_us / 1e6);
+
+    if (playing && data->time >= recorder->next_keyframe) {
+        flushRun(recorder);
+        struct replay_keyframe *keyframe = &recorder->keyframes[recorder->keyframe_count];
+        keyframe->step = recorder->steps;
+        keyframe->offset = recorder->offset;
+        keyframe->pressed = pressed;
+        keyframe->padding = 0;
+        keyframe->state = *data;
+        recorder->keyframe_count = recorder->keyframe_count + 1;
+        //the replay still plays without more keyframes, it just seeks more slowly past the last one
+        recorder->next_keyframe = recorder->keyframe_count < REPLAY_MAX_KEYFRAMES ? recorder->next_keyframe + REPLAY_KEYFRAME_INTERVAL : DBL_MAX;
+    }
+    return playing;
+}
+
+bool finishRecording(struct recorder *recorder, struct game_data *data) {
+    flushRun(recorder);
+    //keyframes are read in place from the map, so line them up to 8 bytes
+    uint8_t padding[8] = {0};
+    size_t pad = (8 - recorder->offset % 8) % 8;
+    fwrite(padding, 1, pad, recorder->file);
+    recorder->offset = recorder->offset + pad;
+
+    struct replay_footer footer;
+    memset(&footer, 0, sizeof(footer));
+    footer.steps = recorder->steps;
+    footer.keyframes = recorder->keyframe_count;
+    footer.keyframes_offset = recorder->offset;
+    footer.score = data->score;
+    footer.lines = data->lines;
+    footer.level = data->level;
+    footer.pieces = data->pieces;
+    footer.topped_out = data->over;
+    footer.magic = REPLAY_MAGIC;
+    fwrite(recorder->keyframes, sizeof(struct replay_keyframe), recorder->keyframe_count, recorder->file);
+    fwrite(&footer, sizeof(footer), 1, recorder->file);
+    free(recorder->keyframes);
+    recorder->keyframes = NULL;
+    bool written = !ferror(recorder->file);
+    written = fclose(recorder->file) == 0 && written;
+    recorder->file = NULL;
+    return written;
+}
+
+bool openReplay(struct replay *replay, const char *path, struct game_data *data) {
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size < (off_t) sizeof(struct replay_header)) {
+        close(file);
+        return false;
+    }
+    void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    replay->map = map;
+    replay->size = info.st_size;
+    replay->header = map;
+    if (replay->header->magic != REPLAY_MAGIC || replay->header->version != REPLAY_VERSION) {
+        closeReplay(replay);
+        return false;
+    }
+
+    replay->footer = NULL;
+    replay->keyframes = NULL;
+    replay->end = replay->size;
+    if (replay->size >= sizeof(struct replay_header) + sizeof(struct replay_footer)) {
+        const struct replay_footer *footer = (const void *) (replay->map + replay->size - sizeof(struct replay_footer));
+        if (footer->magic == REPLAY_MAGIC && footer->keyframes_offset <= replay->size - sizeof(struct replay_footer)
+            && footer->keyframes == (replay->size - sizeof(struct replay_footer) - footer->keyframes_offset) / sizeof(struct replay_keyframe)) {
+            replay->footer = footer;
+            replay->end = footer->keyframes_offset;
+            //keyframes from a build with a different game_data can't be used, but the records still can
+            if (replay->header->state_size == sizeof(struct game_data)) {
+                replay->keyframes = (const void *) (replay->map + footer->keyframes_offset);
+            }
+        }
+    }
+
+    initGame(data, replay->header->seed);
+    applySettings(data, replay->header->settings);
+    replay->position = sizeof(struct replay_header);
+    replay->step = 0;
+    replay->pressed = 0;
+    replay->run_count = 0;
+    return true;
+}
+
+void closeReplay(struct replay *replay) {
+    munmap((void *) replay->map, replay->size);
+    replay->map = NULL;
+}
+
+bool replayStep(struct replay *replay, struct game_data *data) {
+    //the records are padded out to line the keyframes up, so a finished replay ends at its step count rather than its last byte
+    if (replay->footer != NULL && replay->step >= replay->footer->steps) {
+        return false;
+    }
+    uint32_t just_pressed = 0;
+    uint64_t dt_us;
+    if (replay->run_count > 0) {
+        dt_us = replay->run_dt;
+        replay->run_count = replay->run_count - 1;
+    } else {
+        uint64_t value;
+        if (!readVarint(replay->map, &replay->position, replay->end, &value)) {
+            return false;
+        }
+        dt_us = value >> 3;
+        //a record cut short means the replay is damaged, and playing on with the wrong keys would only go out of step
+        uint64_t field;
+        if (value & RECORD_PRESSED) {
+            if (!readVarint(replay->map, &replay->position, replay->end, &field)) {
+                return false;
+            }
+            replay->pressed = field;
+        }
+        if (value & RECORD_JUST_PRESSED) {
+            if (!readVarint(replay->map, &replay->position, replay->end, &field)) {
+                return false;
+            }
+            just_pressed = field;
+        }
+        if (value & RECORD_REPEATS) {
+            if (!readVarint(replay->map, &replay->position, replay->end, &field)) {
+                return false;
+            }
+            replay->run_dt = dt_us;
+            replay->run_count = field;
+        }
+    }
+    replay->step = replay->step + 1;
+    return gameStep(data, (struct inputs) {maskPresses(replay->pressed), maskPresses(just_pressed)}, dt_us / 1e6);
+}
+
+bool seekReplay(struct replay *replay, struct game_data *data, double time) {
+    //start from the last keyframe before time, or from the beginning if there isn't one
+    int low = 0;
+    int high = replay->keyframes != NULL ? replay->footer->keyframes : 0;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (replay->keyframes[middle].state.time <= time) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low > 0) {
+        const struct replay_keyframe *keyframe = &replay->keyframes[low - 1];
+        *data = keyframe->state;
+        replay->position = keyframe->offset;
+        replay->step = keyframe->step;
+        replay->pressed = keyframe->pressed;
+        replay->run_count = 0;
+    } else {
+        initGame(data, replay->header->seed);
+        applySettings(data, replay->header->settings);
+        replay->position = sizeof(struct replay_header);
+        replay->step = 0;
+        replay->pressed = 0;
+        replay->run_count = 0;
+    }
+    while (data->time < time) {
+        if (!replayStep(replay, data)) {
+            return data->time >= time;
+        }
+    }
+    return true;
+}
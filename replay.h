@@ -0,0 +1,111 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "engine.h"
+
+//a replay is the seed and settings of a game and the inputs of every step, which is enough to play the whole game again
+//laid out as a header, the step records, the keyframes and a footer:
+//  each step record is varint(dt in microseconds << 3 | flags) followed by varint(pressed) if the flags say the held
+//  keys changed, varint(just_pressed) if any were pressed that step and varint(repeats) if the same step with no
+//  new presses happened again that many more times
+//  a keyframe is a copy of game_data every REPLAY_KEYFRAME_INTERVAL seconds of play with the offset of the next record,
+//  so seeking only has to play from the keyframe before
+//  the footer holds the final results and where the keyframes are. a replay cut short without one still plays from the start
+
+#define REPLAY_MAGIC 0x50525454
+#define REPLAY_VERSION 2
+#define REPLAY_KEYFRAME_INTERVAL 30.0
+//keyframes a recording has room for, two hours of play. later parts of longer games have none
+#define REPLAY_MAX_KEYFRAMES 240
+//names startNewRecording tries before giving up on a directory
+#define REPLAY_NAME_ATTEMPTS 1000
+
+#define RECORD_PRESSED 1
+#define RECORD_JUST_PRESSED 2
+#define RECORD_REPEATS 4
+
+struct replay_header {
+    uint32_t magic;
+    uint32_t version;
+    //keyframes are raw copies of game_data, so they only load into a build where it's the same size
+    uint32_t state_size;
+    uint32_t padding;
+    uint64_t seed;
+    //unix time the game was played at
+    int64_t started;
+    struct settings settings;
+};
+
+struct replay_keyframe {
+    uint64_t step;
+    //offset of the first record after the keyframe, from the start of the file
+    uint64_t offset;
+    //keys held down at the keyframe, which the records after it only give as changes
+    uint32_t pressed;
+    uint32_t padding;
+    struct game_data state;
+};
+
+struct replay_footer {
+    uint64_t steps;
+    uint64_t keyframes;
+    //offset of the first keyframe, which is also where the records end
+    uint64_t keyframes_offset;
+    int32_t score;
+    int32_t lines;
+    int32_t level;
+    int32_t pieces;
+    uint32_t topped_out;
+    uint32_t magic;
+};
+
+struct recorder {
+    FILE *file;
+    uint64_t offset;
+    uint64_t steps;
+    uint32_t pressed;
+    //a step that keeps happening with no new presses is held back until something different comes along
+    uint64_t run_dt;
+    uint64_t run_count;
+    double next_keyframe;
+    //REPLAY_MAX_KEYFRAMES of them, or NULL if there wasn't the memory
+    struct replay_keyframe *keyframes;
+    int keyframe_count;
+};
+
+struct replay {
+    const uint8_t *map;
+    size_t size;
+    const struct replay_header *header;
+    //NULL if the replay was never finished
+    const struct replay_footer *footer;
+    const struct replay_keyframe *keyframes;
+    size_t position;
+    size_t end;
+    uint64_t step;
+    uint32_t pressed;
+    uint64_t run_dt;
+    uint64_t run_count;
+};
+
+//starts writing a replay of a game that initGame has just set up with seed. returns false if the file can't be written
+bool startRecording(struct recorder *recorder, const char *path, struct game_data *data, uint64_t seed);
+//like startRecording but into a new file in directory named after the seed, with -2, -3 and so on added if that's taken
+//never replaces a file that's already there. the file's path is written into path
+bool startNewRecording(struct recorder *recorder, const char *directory, struct game_data *data, uint64_t seed, char *path, size_t size);
+//steps the game like gameStep and records the step. dt is rounded to the microsecond so the replay plays back exactly
+bool recordStep(struct recorder *recorder, struct game_data *data, struct inputs inputs, double dt);
+//writes the keyframes and results and closes the file
+bool finishRecording(struct recorder *recorder, struct game_data *data);
+
+//maps a replay into memory and sets data up as the game started. returns false if it isn't a replay this build can play
+bool openReplay(struct replay *replay, const char *path, struct game_data *data);
+void closeReplay(struct replay *replay);
+//plays the next recorded step, returns false at the end of the replay or once the game is over
+bool replayStep(struct replay *replay, struct game_data *data);
+//jumps to the first step at or after time seconds into the game
+bool seekReplay(struct replay *replay, struct game_data *data, double time);
+
+#endif
@@ -0,0 +1,354 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "engine.h"
+#include "agents.h"
+#include "eval.h"
+#include "replay.h"
+#include "pool.h"
+
+//plays lots of games without a display, as fast as the cores allow, and sums up how they went
+
+struct result {
+    int score;
+    int lines;
+    int level;
+    int pieces;
+    long steps;
+    struct agent_stats stats;
+    bool topped_out;
+};
+
+struct simulation {
+    const struct agent *agent;
+    const char *agent_options;
+    struct settings settings;
+    uint64_t seed;
+    double step;
+    int max_pieces;
+    double max_time;
+    //directory to record every game in, or NULL
+    const char *replays;
+    //agent state for each worker, state_size bytes apiece
+    char *agent_states;
+    struct result *results;
+};
+
+double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+void playGame(void *context, int index, int worker) {
+    struct simulation *sim = context;
+    void *state = sim->agent_states + sim->agent->state_size * worker;
+    memset(state, 0, sim->agent->state_size);
+
+    struct game_data data;
+    initGame(&data, sim->seed + index);
+    applySettings(&data, sim->settings);
+    sim->agent->start(state, sim->seed + index, sim->agent_options);
+
+    struct recorder recorder;
+    bool recording = false;
+    if (sim->replays != NULL) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%llu.ttr", sim->replays, (unsigned long long) (sim->seed + index));
+        recording = startRecording(&recorder, path, &data, sim->seed + index);
+        if (!recording) {
+            fprintf(stderr, "couldn't record the game to %s\n", path);
+        }
+    }
+
+    struct result *result = &sim->results[index];
+    result->steps = 0;
+    result->topped_out = false;
+    while (data.pieces < sim->max_pieces && data.time < sim->max_time) {
+        result->steps = result->steps + 1;
+        struct inputs inputs = sim->agent->act(state, &data);
+        if (!(recording ? recordStep(&recorder, &data, inputs, sim->step) : gameStep(&data, inputs, sim->step))) {
+            result->topped_out = true;
+            break;
+        }
+    }
+    if (recording) {
+        finishRecording(&recorder, &data);
+    }
+    result->stats = (struct agent_stats) {0, 0};
+    if (sim->agent->finish != NULL) {
+        sim->agent->finish(state, &result->stats);
+    }
+    result->score = data.score;
+    result->lines = data.lines;
+    result->level = data.level;
+    result->pieces = data.pieces;
+}
+
+int compareInts(const void *a, const void *b) {
+    int x = *(const int *) a;
+    int y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+//prints the spread of one number across all the games. values is sorted in place
+void printDistribution(const char *name, int values[], int count) {
+    qsort(values, count, sizeof(int), compareInts);
+    double total = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        total = total + values[i];
+    }
+    printf("%-8s mean %10.1f  min %8d  p10 %8d  p50 %8d  p90 %8d  p99 %8d  max %8d\n", name, total / count,
+           values[0], values[count / 10], values[count / 2], values[count * 9 / 10], values[count * 99 / 100], values[count - 1]);
+}
+
+void printHistogram(int sorted[], int count) {
+    int buckets[10] = {0};
+    int width = sorted[count - 1] / 10 + 1;
+    int i;
+    for (i = 0; i < count; i++) {
+        buckets[sorted[i] / width] = buckets[sorted[i] / width] + 1;
+    }
+    int biggest = 1;
+    for (i = 0; i < 10; i++) {
+        biggest = buckets[i] > biggest ? buckets[i] : biggest;
+    }
+    for (i = 0; i < 10; i++) {
+        printf("  %8d - %8d %8d ", i * width, (i + 1) * width - 1, buckets[i]);
+        int bar;
+        for (bar = 0; bar < buckets[i] * 50 / biggest; bar++) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
+
+//checks every evaluation kernel the cpu supports against the scalar one on random boards and times them
+//returns false if any of them disagree
+bool checkEval(int count, uint64_t seed) {
+    uint16_t (*boards)[BOARD_HEIGHT] = malloc(sizeof(*boards) * count);
+    const uint16_t **pointers = malloc(sizeof(uint16_t *) * count);
+    struct eval_features *expected = malloc(sizeof(struct eval_features) * count);
+    struct eval_features *features = malloc(sizeof(struct eval_features) * count);
+    uint64_t random = seed * 0x9E3779B97F4A7C15ULL + 1;
+    int i, y;
+    for (i = 0; i < count; i++) {
+        //mostly ordinary stacks, with the odd one right up to the top
+        int height = nextRandom(&random) % (i % 8 == 0 ? BOARD_HEIGHT + 1 : 21);
+        uint16_t density = nextRandom(&random);
+        for (y = 0; y < BOARD_HEIGHT; y++) {
+            uint16_t cells = nextRandom(&random) | (y < 10 ? density : 0);
+            boards[i][y] = y < height ? EMPTY_ROW | (cells & FIELD_MASK) : EMPTY_ROW;
+        }
+        pointers[i] = boards[i];
+        boardFeatures(boards[i], &expected[i]);
+    }
+
+    bool matched = true;
+    int kernel;
+    for (kernel = 0; kernel < EVAL_KERNELS; kernel++) {
+        if (!evalKernelSupported(kernel)) {
+            printf("%-8s not supported\n", eval_kernel_names[kernel]);
+            continue;
+        }
+        double start = now();
+        batchFeaturesWith(kernel, pointers, count, features);
+        double elapsed = now() - start;
+        int mismatches = 0;
+        for (i = 0; i < count; i++) {
+            mismatches = mismatches + (memcmp(&features[i], &expected[i], sizeof(struct eval_features)) != 0);
+        }
+        printf("%-8s %12.1f boards/sec  %d mismatches%s\n", eval_kernel_names[kernel], count / elapsed, mismatches,
+               kernel == bestEvalKernel() ? "  (used)" : "");
+        matched = matched && mismatches == 0;
+    }
+
+    free(boards);
+    free(pointers);
+    free(expected);
+    free(features);
+    return matched;
+}
+
+bool parseScoring(const char *text, int scoring[4]) {
+    return sscanf(text, "%d,%d,%d,%d", &scoring[0], &scoring[1], &scoring[2], &scoring[3]) == 4;
+}
+
+void usage(const char *name) {
+    fprintf(stderr, "usage: %s [options]\n"
+                    "  -n games       number of games to play (1000)\n"
+                    "  -t threads     threads to play them on (all cores)\n"
+                    "  -s seed        seed of the first game, game i uses seed + i (1)\n"
+                    "  -a agent       agent playing the games (random)\n"
+                    "  -o options     options passed to the agent\n"
+                    "  -p pieces      stop a game after this many pieces (1000)\n"
+                    "  -m seconds     stop a game after this much game time (3600)\n"
+                    "  -d seconds     length of each step (1/60)\n"
+                    "  -l seconds     lock delay\n"
+                    "  -D seconds     DAS\n"
+                    "  -r seconds     ARR\n"
+                    "  -g base        gravity curve base\n"
+                    "  -G step        gravity curve step per level\n"
+                    "  -i             20G, pieces fall straight to the stack at every level\n"
+                    "  -c a,b,c,d     points for 1 to 4 lines\n"
+                    "  -w directory   record every game in directory, for agents that are replayable\n"
+                    "  -e boards      check the evaluation kernels against each other on this many boards and exit\n"
+                    "agents:\n", name);
+    int i;
+    for (i = 0; agents[i] != NULL; i++) {
+        fprintf(stderr, "  %-14s %s\n", agents[i]->name, agents[i]->description);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    struct simulation sim = {findAgent("random"), NULL, default_settings, 1, 1 / 60.0, 1000, 3600, NULL, NULL, NULL};
+    int games = 1000;
+    int threads = poolCores();
+    int eval_boards = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:t:s:a:o:p:m:d:l:D:r:g:G:ic:w:e:h")) != -1) {
+        switch (option) {
+            case 'n':
+                games = atoi(optarg);
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 's':
+                sim.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'a':
+                sim.agent = findAgent(optarg);
+                if (sim.agent == NULL) {
+                    fprintf(stderr, "unknown agent %s\n", optarg);
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'o':
+                sim.agent_options = optarg;
+                break;
+            case 'p':
+                sim.max_pieces = atoi(optarg);
+                break;
+            case 'm':
+                sim.max_time = atof(optarg);
+                break;
+            case 'd':
+                sim.step = atof(optarg);
+                break;
+            case 'l':
+                sim.settings.lock_delay = atof(optarg);
+                break;
+            case 'D':
+                sim.settings.das = atof(optarg);
+                break;
+            case 'r':
+                sim.settings.arr = atof(optarg);
+                break;
+            case 'g':
+                sim.settings.gravity_base = atof(optarg);
+                break;
+            case 'G':
+                sim.settings.gravity_step = atof(optarg);
+                break;
+            case 'i':
+                sim.settings.instant_gravity = true;
+                break;
+            case 'c':
+                if (!parseScoring(optarg, sim.settings.scoring)) {
+                    fprintf(stderr, "scoring should look like 100,300,500,800\n");
+                    return 1;
+                }
+                break;
+            case 'w':
+                sim.replays = optarg;
+                break;
+            case 'e':
+                eval_boards = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if (games < 1 || sim.step <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (eval_boards > 0) {
+        return checkEval(eval_boards, sim.seed) ? 0 : 1;
+    }
+    if (sim.replays != NULL) {
+        if (!sim.agent->replayable) {
+            fprintf(stderr, "%s places pieces without going through the inputs, so its games can't be recorded\n", sim.agent->name);
+            return 1;
+        }
+        mkdir(sim.replays, 0755);
+    }
+
+    sim.agent_states = malloc(sim.agent->state_size * threads + 1);
+    sim.results = malloc(sizeof(struct result) * games);
+
+    double start = now();
+    poolRun(threads, games, playGame, &sim);
+    double elapsed = now() - start;
+
+    long pieces = 0;
+    long steps = 0;
+    long nodes = 0;
+    long hits = 0;
+    int topped_out = 0;
+    int *values = malloc(sizeof(int) * games);
+    int i;
+    for (i = 0; i < games; i++) {
+        pieces = pieces + sim.results[i].pieces;
+        steps = steps + sim.results[i].steps;
+        nodes = nodes + sim.results[i].stats.nodes;
+        hits = hits + sim.results[i].stats.hits;
+        topped_out = topped_out + sim.results[i].topped_out;
+    }
+
+    printf("agent      %s\n", sim.agent->name);
+    printf("games      %d on %d threads in %.3f s\n", games, threads, elapsed);
+    printf("games/sec  %.1f\n", games / elapsed);
+    printf("pieces/sec %.1f\n", pieces / elapsed);
+    printf("steps/sec  %.1f\n", steps / elapsed);
+    if (nodes > 0) {
+        printf("nodes/sec  %.1f\n", nodes / elapsed);
+        printf("tt hits    %.1f%%\n", 100.0 * hits / nodes);
+    }
+    printf("topped out %d (%.1f%%)\n", topped_out, 100.0 * topped_out / games);
+
+    for (i = 0; i < games; i++) {
+        values[i] = sim.results[i].lines;
+    }
+    printDistribution("lines", values, games);
+    for (i = 0; i < games; i++) {
+        values[i] = sim.results[i].level;
+    }
+    printDistribution("level", values, games);
+    for (i = 0; i < games; i++) {
+        values[i] = sim.results[i].pieces;
+    }
+    printDistribution("pieces", values, games);
+    for (i = 0; i < games; i++) {
+        values[i] = sim.results[i].score;
+    }
+    printDistribution("score", values, games);
+    printHistogram(values, games);
+
+    free(values);
+    free(sim.results);
+    free(sim.agent_states);
+    return 0;
+}
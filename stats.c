@@ -0,0 +1,67 @@
+#include <string.h>
+#include "stats.h"
+
+const char *phase_names[PHASES] = {"input", "logic", "draw", "draw_board", "draw_pieces", "draw_text", "present", "sleep", "frame"};
+
+int histogramBucket(uint32_t value) {
+    if (value < HISTOGRAM_LINEAR) {
+        return value;
+    }
+    //the highest set bit picks the doubling and the 5 bits under it pick the bucket within it
+    int top = 31 - __builtin_clz(value);
+    int bucket = HISTOGRAM_LINEAR + (top - 6) * HISTOGRAM_SUB_BUCKETS + ((value >> (top - 5)) & (HISTOGRAM_SUB_BUCKETS - 1));
+    return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+//the largest value that lands in bucket
+uint32_t bucketTop(int bucket) {
+    if (bucket < HISTOGRAM_LINEAR) {
+        return bucket;
+    }
+    int top = (bucket - HISTOGRAM_LINEAR) / HISTOGRAM_SUB_BUCKETS + 6;
+    uint32_t sub = (bucket - HISTOGRAM_LINEAR) % HISTOGRAM_SUB_BUCKETS;
+    return ((HISTOGRAM_SUB_BUCKETS + sub + 1) << (top - 5)) - 1;
+}
+
+void histogramAdd(struct histogram *histogram, uint32_t microseconds) {
+    histogram->counts[histogramBucket(microseconds)]++;
+    histogram->count = histogram->count + 1;
+    histogram->total = histogram->total + microseconds;
+    histogram->max = microseconds > histogram->max ? microseconds : histogram->max;
+}
+
+uint32_t histogramPercentile(struct histogram *histogram, double fraction) {
+    uint64_t wanted = fraction * histogram->count;
+    uint64_t seen = 0;
+    int i;
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen = seen + histogram->counts[i];
+        if (seen > wanted) {
+            //the middle of the bucket, which can be past the biggest value actually seen
+            uint32_t middle = i > 0 ? (bucketTop(i - 1) + 1 + bucketTop(i)) / 2 : 0;
+            return middle < histogram->max ? middle : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void resetFrameStats(struct frame_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void writeHistogram(const char *name, struct histogram *histogram, FILE *file) {
+    fprintf(file, "%s,%llu,%.1f,%u,%u,%u,%u\n", name, (unsigned long long) histogram->count,
+            histogram->count > 0 ? (double) histogram->total / histogram->count : 0.0, histogramPercentile(histogram, 0.5),
+            histogramPercentile(histogram, 0.9), histogramPercentile(histogram, 0.99), histogram->max);
+}
+
+bool writeFrameStats(struct frame_stats *stats, FILE *file) {
+    fprintf(file, "phase,count,mean_us,p50_us,p90_us,p99_us,max_us\n");
+    int i;
+    for (i = 0; i < PHASES; i++) {
+        writeHistogram(phase_names[i], &stats->phases[i], file);
+    }
+    writeHistogram("jitter", &stats->jitter, file);
+    fprintf(file, "\nframes,dropped\n%ld,%ld\n", stats->frames, stats->dropped);
+    return !ferror(file);
+}
@@ -0,0 +1,58 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//histograms of how long things take, cheap enough to add to every frame
+
+//values under 64 microseconds get a bucket each, above that every doubling is split into 32 buckets,
+//so a bucket is never more than about 3% wide and anything up to a minute fits
+#define HISTOGRAM_LINEAR 64
+#define HISTOGRAM_SUB_BUCKETS 32
+#define HISTOGRAM_BUCKETS (HISTOGRAM_LINEAR + 21 * HISTOGRAM_SUB_BUCKETS)
+
+struct histogram {
+    uint32_t counts[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    //sum and largest of every value, in microseconds
+    uint64_t total;
+    uint32_t max;
+};
+
+//the parts each frame of the game is split into
+enum phases {
+    PHASE_INPUT,
+    PHASE_LOGIC,
+    //all of drawGame, which is made up of the three after it
+    PHASE_DRAW,
+    PHASE_DRAW_BOARD,
+    PHASE_DRAW_PIECES,
+    PHASE_DRAW_TEXT,
+    PHASE_PRESENT,
+    PHASE_SLEEP,
+    //the whole frame, sleep included
+    PHASE_FRAME,
+    PHASES
+};
+
+extern const char *phase_names[PHASES];
+
+struct frame_stats {
+    struct histogram phases[PHASES];
+    //how far each frame started from when it should have, by the pacing's target rate
+    struct histogram jitter;
+    long frames;
+    //frames whose work took longer than the frame budget, so they couldn't be shown on time
+    long dropped;
+};
+
+void histogramAdd(struct histogram *histogram, uint32_t microseconds);
+//the value below which fraction of the values fall, to within a bucket
+uint32_t histogramPercentile(struct histogram *histogram, double fraction);
+void resetFrameStats(struct frame_stats *stats);
+//writes a line per phase and one for the jitter with the count, mean, percentiles and max in microseconds, then the frame counts
+bool writeFrameStats(struct frame_stats *stats, FILE *file);
+
+#endif
@@ -1,45 +1,40 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_timer.h>
-#include <SDL2/SDL_image.h>
-#include <SDL2/SDL_ttf.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "engine.h"
+#include "bot.h"
+#include "replay.h"
+#include "stats.h"
+#include "arena.h"
+#include "trace.h"
+#include "packed.h"
 
-#define SDROP_GRAVITY 0.05
-#define LOCK_DELAY 0.5
-#define DAS 0.133
-#define ARR 0.02
-
-#define WINDOW_WIDTH 800
-#define WINDOW_HEIGHT 600
 #define SQUARE_SIZE 20
+//scratch memory for each frame
+#define FRAME_ARENA_SIZE (256 * 1024)
+//frames after changing state in which allocations aren't counted against --alloc-check, while games start and layers are drawn
+#define ALLOC_WARMUP 120
 
-struct block{
-    bool exists;
-    SDL_Colour col;
-};
+struct presses presses_default = {false, false, false, false, false, false, false, false, false, false};
 
-struct tetromino {
-    bool base[4][4];
-    char type;
-    int x;
-    int y;
+//how frames are paced: waiting for the display's vsync in present, as fast as they can go,
+//or sleeping most of the way to the display's next refresh and spinning the rest
+enum pacing {
+    PACING_VSYNC,
+    PACING_UNCAPPED,
+    PACING_HYBRID,
+    PACINGS
 };
 
-struct presses {
-    bool rotc;
-    bool sdrop;
-    bool right;
-    bool left;
-    bool enter;
-    bool hdrop;
-    bool rota;
-    bool rot180;
-    bool hold;
-    bool quit;
-};
-struct presses presses_default = {false, false, false, false, false, false, false, false, false, false};
+const char *pacing_names[PACINGS] = {"vsync", "uncapped", "hybrid"};
+
+//SDL_Delay can wake a millisecond or two late, so the hybrid pacing stops sleeping this far from the next frame and spins
+#define PACING_SPIN_MS 2
 
 enum states{
     MENU_STATE,
@@ -65,29 +60,41 @@ const struct block_colours {
     {255, 255, 0, 255}
 };
 
-struct game_data {
-    int level;
-    int score;
-    int lines;
-    struct tetromino current;
-    struct tetromino upcoming[14];
-    struct block matrix[40][10];
-    double last_drop;
-    double right_das;
-    double left_das;
-    double last_das_move;
-    bool locking;
-    double started_locking;
-    struct tetromino hold_piece;
-    bool holding;
-    bool has_been_held;
+//printable ascii in the packed atlas, so text is drawn as quads from it instead of being rendered every frame
+struct glyph_atlas {
+    SDL_Texture *texture;
+    SDL_Rect glyphs[GLYPH_COUNT];
+    //how far along the next glyph starts
+    int advances[GLYPH_COUNT];
+};
+
+//the longest text that can be laid out
+#define TEXT_LENGTH 64
+
+//text laid out as quads from an atlas, kept so it's only laid out again when it changes
+struct text {
+    char string[TEXT_LENGTH];
+    struct glyph_atlas *atlas;
+    SDL_Colour col;
+    float x;
+    float y;
+    int count;
+    SDL_Rect sources[TEXT_LENGTH];
+    SDL_Rect targets[TEXT_LENGTH];
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    SDL_Vertex vertices[TEXT_LENGTH * 4];
+    int indices[TEXT_LENGTH * 6];
+#endif
 };
 
+//everything is in one texture uploaded from packed_pixels, these are where each image is in it
 struct assets {
-    SDL_Texture *logo;
-    SDL_Texture *play_button;
-    SDL_Texture *end;
-    TTF_Font *font;
+    SDL_Texture *atlas;
+    SDL_Rect logo;
+    SDL_Rect play_button;
+    SDL_Rect end;
+    struct glyph_atlas font_atlas;
+    struct glyph_atlas small_atlas;
 };
 
 struct pos {
@@ -95,88 +102,124 @@ struct pos {
     float y;
 };
 
-const struct block_rotations {
-    struct pos I;
-    struct pos Z;
-    struct pos S;
-    struct pos T;
-    struct pos L;
-    struct pos J;
-    struct pos O;
-} BLOCK_ROTATIONS = {
-    {2, 2},
-    {1.5, 1.5},
-    {1.5, 1.5},
-    {1.5, 1.5},
-    {1.5, 1.5},
-    {1.5, 1.5},
-    {2, 1}
+//filled rectangles for the board, grid and pieces, sent to the renderer together instead of a call each
+#define BATCH_SIZE 512
+
+struct batch {
+    SDL_Rect rects[BATCH_SIZE];
+    SDL_Colour colours[BATCH_SIZE];
+    //rects in a later layer can cover ones in an earlier layer, so when falling back to a call per colour,
+    //rects are only merged with others in the same layer
+    int layers[BATCH_SIZE];
+    int layer;
+    int count;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    SDL_Vertex vertices[BATCH_SIZE * 4];
+    int indices[BATCH_SIZE * 6];
+#endif
+    //set once SDL_RenderGeometry has failed, after which batches go through SDL_RenderFillRects a colour at a time
+    bool no_geometry;
+};
+
+//things that don't change from one frame to the next, drawn once into textures and copied to the screen each frame
+struct layers {
+    //each layer is NULL if the renderer can't draw into textures or it couldn't be made, in which case what it
+    //holds is drawn every frame
+    //the grid, border and locked stack, drawn again when the board version changes
+    SDL_Texture *board;
+    int board_version;
+    //the menu and end screens, indexed by state. the game's is left NULL
+    SDL_Texture *screens[3];
+    bool screens_drawn[3];
 };
 
 struct assets assets;
 
-//define shapes of tetrominoes
-const bool O[4][4] = {{0, 1, 1, 0}, 
-                      {0, 1, 1, 0}, 
-                      {0, 0, 0, 0},
-                      {0, 0, 0, 0}};
+struct layers layers;
 
-const bool I[4][4] = {{0, 0, 0, 0}, 
-                      {1, 1, 1, 1}, 
-                      {0, 0, 0, 0},
-                      {0, 0, 0, 0}};
+//the level and score, laid out again only when they change
+struct text level_text;
+struct text score_text;
 
-const bool S[4][4] = {{0, 1, 1, 0}, 
-                      {1, 1, 0, 0}, 
-                      {0, 0, 0, 0},
-                      {0, 0, 0, 0}};
+struct batch batch;
 
-const bool Z[4][4] = {{1, 1, 0, 0}, 
-                      {0, 1, 1, 0}, 
-                      {0, 0, 0, 0},
-                      {0, 0, 0, 0}};
+struct frame_stats frame_stats;
 
-const bool L[4][4] = {{0, 0, 1, 0}, 
-                      {1, 1, 1, 0}, 
-                      {0, 0, 0, 0},
-                      {0, 0, 0, 0}};
+//scratch memory for one frame, emptied at the top of every frame
+struct arena frame_arena;
 
-const bool J[4][4] = {{1, 0, 0, 0}, 
-                      {1, 1, 1, 0}, 
-                      {0, 0, 0, 0},
-                      {0, 0, 0, 0}};
+//with --alloc-check every allocation SDL makes goes through here, and the game's own calls to malloc, calloc and realloc
+//are wrapped at link time to be counted too, so frames that touch the heap show up
+//what libc allocates inside its own functions, like fopen, isn't seen
+struct allocations {
+    SDL_malloc_func malloc;
+    SDL_calloc_func calloc;
+    SDL_realloc_func realloc;
+    SDL_free_func free;
+    bool counting;
+    long count;
+    //made during the last frame
+    long last_frame;
+};
 
-const bool T[4][4] = {{0, 1, 0, 0}, 
-                      {1, 1, 1, 0}, 
-                      {0, 0, 0, 0},
-                      {0, 0, 0, 0}};
+struct allocations allocations;
 
-bool tetrominoes[7][4][4];
-const char names[7] = {'I', 'T', 'Z', 'S', 'L', 'J', 'O'};
+void *countedMalloc(size_t size) {
+    __atomic_add_fetch(&allocations.count, 1, __ATOMIC_RELAXED);
+    return allocations.malloc(size);
+}
 
-const int scoring[4] = {100, 300, 500, 800};
+void *countedCalloc(size_t count, size_t size) {
+    __atomic_add_fetch(&allocations.count, 1, __ATOMIC_RELAXED);
+    return allocations.calloc(count, size);
+}
 
-bool collides(struct block matrix[40][10], bool shape[4][4], struct pos pos) {
-    int i, j;
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 4; j++) {
-            if (shape[i][j]) {
-                if (pos.x + j < 0 || pos.x + j > 9 || pos.y - i < 0 || pos.y - i > 40 || matrix[(int) pos.y - i][(int) pos.x + j].exists) {
-                    return true;
-                }
-            }
-        }
+void *countedRealloc(void *pointer, size_t size) {
+    __atomic_add_fetch(&allocations.count, 1, __ATOMIC_RELAXED);
+    return allocations.realloc(pointer, size);
+}
+
+void countedFree(void *pointer) {
+    allocations.free(pointer);
+}
+
+//the game is linked with -Wl,--wrap so its own allocations come through here, SDL's own go through the functions above
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    if (allocations.counting) {
+        __atomic_add_fetch(&allocations.count, 1, __ATOMIC_RELAXED);
     }
-    return false;
+    return __real_malloc(size);
 }
 
-void emptyMatrix(struct block matrix[40][10]) {
-    int i, j;
-    for (i = 0; i < 40; i++) {
-        for (j = 0; j < 10; j++) {
-            matrix[i][j].exists = false;
-        }
+void *__wrap_calloc(size_t count, size_t size) {
+    if (allocations.counting) {
+        __atomic_add_fetch(&allocations.count, 1, __ATOMIC_RELAXED);
     }
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    if (allocations.counting) {
+        __atomic_add_fetch(&allocations.count, 1, __ATOMIC_RELAXED);
+    }
+    return __real_realloc(pointer, size);
+}
+
+//has to happen before SDL allocates anything
+void countAllocations(void) {
+    SDL_GetMemoryFunctions(&allocations.malloc, &allocations.calloc, &allocations.realloc, &allocations.free);
+    allocations.counting = SDL_SetMemoryFunctions(countedMalloc, countedCalloc, countedRealloc, countedFree) == 0;
+}
+
+//adds the time since *since to phase and moves *since on to now
+void timePhase(enum phases phase, Uint64 *since) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    histogramAdd(&frame_stats.phases[phase], (now - *since) * 1000000 / SDL_GetPerformanceFrequency());
+    *since = now;
 }
 
 SDL_Colour getBlockColour(char type) {
@@ -200,254 +243,241 @@ SDL_Colour getBlockColour(char type) {
     }
 }
 
+void flushBatch(SDL_Renderer *renderer) {
+    if (batch.count == 0) {
+        return;
+    }
+    int i, j;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    //every rect as two triangles with the colour in the vertices, so the whole batch is one call
+    if (!batch.no_geometry) {
+        const int quad[6] = {0, 1, 2, 0, 2, 3};
+        for (i = 0; i < batch.count; i++) {
+            SDL_Rect rect = batch.rects[i];
+            SDL_FPoint corners[4] = {{rect.x, rect.y}, {rect.x + rect.w, rect.y}, {rect.x + rect.w, rect.y + rect.h}, {rect.x, rect.y + rect.h}};
+            for (j = 0; j < 4; j++) {
+                batch.vertices[i*4 + j] = (SDL_Vertex) {corners[j], batch.colours[i], {0, 0}};
+            }
+            for (j = 0; j < 6; j++) {
+                batch.indices[i*6 + j] = i*4 + quad[j];
+            }
+        }
+        if (SDL_RenderGeometry(renderer, NULL, batch.vertices, batch.count*4, batch.indices, batch.count*6) == 0) {
+            batch.count = 0;
+            batch.layer = 0;
+            return;
+        }
+        batch.no_geometry = true;
+    }
+#endif
+    //a call per colour in each layer, in the order they first came up
+    SDL_Rect rects[BATCH_SIZE];
+    bool drawn[BATCH_SIZE] = {false};
+    for (i = 0; i < batch.count; i++) {
+        if (drawn[i]) {
+            continue;
+        }
+        SDL_Colour col = batch.colours[i];
+        int count = 0;
+        for (j = i; j < batch.count && batch.layers[j] == batch.layers[i]; j++) {
+            if (!drawn[j] && batch.colours[j].r == col.r && batch.colours[j].g == col.g && batch.colours[j].b == col.b) {
+                rects[count] = batch.rects[j];
+                count = count + 1;
+                drawn[j] = true;
+            }
+        }
+        SDL_SetRenderDrawColor(renderer, col.r, col.g, col.b, 255);
+        SDL_RenderFillRects(renderer, rects, count);
+    }
+    batch.count = 0;
+    batch.layer = 0;
+}
+
+void batchRect(SDL_Renderer *renderer, SDL_Rect rect, SDL_Colour col) {
+    if (batch.count == BATCH_SIZE) {
+        flushBatch(renderer);
+    }
+    col.a = 255;
+    batch.rects[batch.count] = rect;
+    batch.colours[batch.count] = col;
+    batch.layers[batch.count] = batch.layer;
+    batch.count = batch.count + 1;
+}
+
+//rects added after this may cover the ones before
+void batchLayer(void) {
+    batch.layer = batch.layer + 1;
+}
+
 //function to draw empty board
 void drawBoard(SDL_Renderer * renderer, struct pos board_pos, int size) {
-    SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
+    SDL_Colour col = {50, 50, 50, 255};
+    int x = board_pos.x;
+    int y = board_pos.y;
 
+    //each line 1 pixel wide, ends included
     int i;
     for (i = 0; i < 11; i++) {
-        SDL_RenderDrawLine(renderer, board_pos.x + i*size, board_pos.y, board_pos.x +i*size, board_pos.y+size*20);
+        batchRect(renderer, (SDL_Rect) {x + i*size, y, 1, size*20 + 1}, col);
     }
     for (i = 0; i < 21; i++) {
-        SDL_RenderDrawLine(renderer, board_pos.x, board_pos.y+size*i, board_pos.x +10*size, board_pos.y+size*i);
+        batchRect(renderer, (SDL_Rect) {x, y + size*i, 10*size + 1, 1}, col);
     }
 
     //makes it so that there is a 2 pixel wide border
-    SDL_Point border[5] = {{board_pos.x-1, board_pos.y-1}, {board_pos.x-1, board_pos.y+20*size+1}, {board_pos.x+10*size+1, board_pos.y + 20*size+1}, {board_pos.x+10*size+1, board_pos.y-1}, {board_pos.x-1, board_pos.y-1}};
-    SDL_RenderDrawLines(renderer, border, 5);
+    batchRect(renderer, (SDL_Rect) {x - 1, y - 1, 10*size + 3, 1}, col);
+    batchRect(renderer, (SDL_Rect) {x - 1, y + 20*size + 1, 10*size + 3, 1}, col);
+    batchRect(renderer, (SDL_Rect) {x - 1, y - 1, 1, 20*size + 3}, col);
+    batchRect(renderer, (SDL_Rect) {x + 10*size + 1, y - 1, 1, 20*size + 3}, col);
+    batchLayer();
 }
 
 //function to draw a single filled square
 void drawBlock(SDL_Renderer * renderer, struct pos pos, SDL_Colour col) {
-    SDL_SetRenderDrawColor(renderer, col.r, col.g, col.b, 255);
-    SDL_Rect rect = {pos.x, pos.y, SQUARE_SIZE, SQUARE_SIZE};
-    SDL_RenderFillRect(renderer, &rect);
+    batchRect(renderer, (SDL_Rect) {pos.x, pos.y, SQUARE_SIZE, SQUARE_SIZE}, col);
 }
 
-void drawMatrix(SDL_Renderer * renderer, struct block matrix[][10], struct pos board_pos) {
+void drawMatrix(SDL_Renderer * renderer, struct board *matrix, struct pos board_pos) {
+    TRACE_ZONE("drawMatrix");
     int i, j;
     for (i = 0; i < 20; i++) {
-        for (j = 0; j < 10; j++) {
-            if (matrix[i][j].exists) {
-                drawBlock(renderer, (struct pos) {board_pos.x + j*SQUARE_SIZE, board_pos.y + (19-i)*SQUARE_SIZE}, matrix[i][j].col);
-            }
+        if (matrix->rows[i] == EMPTY_ROW) {
+            continue;
         }
-    }
-}
-
-void drawShape(SDL_Renderer *renderer, bool piece[4][4], struct pos pos, SDL_Colour col) {
-    int i, j;
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 4; j++) {
-            if (piece[i][j]) {
-                drawBlock(renderer, (struct pos) {pos.x + j*SQUARE_SIZE, pos.y + i*SQUARE_SIZE}, col);
+        for (j = 0; j < BOARD_WIDTH; j++) {
+            if (matrix->colours[i][j]) {
+                drawBlock(renderer, (struct pos) {board_pos.x + j*SQUARE_SIZE, board_pos.y + (19-i)*SQUARE_SIZE}, getBlockColour(matrix->colours[i][j]));
             }
         }
     }
 }
 
-void duplicateBase(bool base[][4], bool target[][4]) {
-    int i, j;
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 4; j++) {
-            target[i][j] = base[i][j];
-        }
+//makes every layer be drawn again the next time it's used
+void invalidateLayers(void) {
+    layers.board_version = -1;
+    int i;
+    for (i = 0; i < 3; i++) {
+        layers.screens_drawn[i] = false;
     }
 }
 
-void initTetrominoes() {
-    duplicateBase((bool (*)[4])I, tetrominoes[0]);
-    duplicateBase((bool (*)[4])T, tetrominoes[1]);
-    duplicateBase((bool (*)[4])Z, tetrominoes[2]);
-    duplicateBase((bool (*)[4])S, tetrominoes[3]);
-    duplicateBase((bool (*)[4])L, tetrominoes[4]);
-    duplicateBase((bool (*)[4])J, tetrominoes[5]);
-    duplicateBase((bool (*)[4]) O, tetrominoes[6]);
-}
-
-void getTetrominoes(bool tetrs[][4][4]) {
+void initLayers(SDL_Renderer *renderer) {
+    memset(&layers, 0, sizeof(struct layers));
+    invalidateLayers();
+    if (!SDL_RenderTargetSupported(renderer)) {
+        return;
+    }
+    layers.board = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, 10*SQUARE_SIZE + 3, 20*SQUARE_SIZE + 3);
+    //the game changes every frame, so only the menu and end screens get one
+    enum states cached[2] = {MENU_STATE, END_STATE};
     int i;
-    for (i = 0; i < 7; i++) {
-        duplicateBase(tetrominoes[i], tetrs[i]);
+    for (i = 0; i < 2; i++) {
+        layers.screens[cached[i]] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, WINDOW_WIDTH, WINDOW_HEIGHT);
     }
 }
 
-void getTetrominoesNames(char nams[7]) {
+void freeLayers(void) {
     int i;
-    for (i = 0; i < 7; i++) {
-        nams[i] = names[i];
+    for (i = 0; i < 3; i++) {
+        if (layers.screens[i] != NULL) {
+            SDL_DestroyTexture(layers.screens[i]);
+        }
     }
-}
-
-const bool (*getShape(char type))[4][4] {
-    switch(type) {
-        case 'I':
-            return &I;
-        case 'T':
-            return &T;
-        case 'L':
-            return &L;
-        case 'J':
-            return &J;
-        case 'S':
-            return &S;
-        case 'Z':
-            return &Z;
-        case 'O':
-            return &O;
+    if (layers.board != NULL) {
+        SDL_DestroyTexture(layers.board);
     }
-    return &I;
 }
 
-int getDroppedPos(struct block matrix[40][10], struct tetromino piece) {
-    int drop = 0;
-    while (true) {
-        if (collides(matrix, piece.base, (struct pos) {piece.x, piece.y - drop})) {
-            return drop - 1;
-        }
-        drop = drop + 1;
+//draws the grid, border and stack, from the board layer if the stack hasn't changed since it was drawn
+void drawBoardLayer(SDL_Renderer *renderer, struct board *matrix, int version, struct pos board_pos) {
+    if (layers.board == NULL) {
+        drawBoard(renderer, board_pos, SQUARE_SIZE);
+        drawMatrix(renderer, matrix, board_pos);
+        return;
     }
+    if (layers.board_version != version) {
+        //the layer starts a pixel up and left of the board to fit the border
+        SDL_SetRenderTarget(renderer, layers.board);
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderClear(renderer);
+        drawBoard(renderer, (struct pos) {1, 1}, SQUARE_SIZE);
+        drawMatrix(renderer, matrix, (struct pos) {1, 1});
+        flushBatch(renderer);
+        SDL_SetRenderTarget(renderer, NULL);
+        layers.board_version = version;
+    }
+    SDL_Rect target = {board_pos.x - 1, board_pos.y - 1, 10*SQUARE_SIZE + 3, 20*SQUARE_SIZE + 3};
+    SDL_RenderCopy(renderer, layers.board, NULL, &target);
 }
 
-//here we generate a new array of 7 blocks and add those blocks to the array 'upcoming' from the point 'from'
-void extendUpcoming(struct tetromino upcoming[], int from) {
-    struct tetromino selection[7];
-
-    char choice_names[7];
-    getTetrominoesNames(choice_names);
-
-    int length;
-    for (length = 0; length < 7; length++) {
-        int random = rand() % (7-length);
-        struct tetromino temp;
-
-        bool (*shape)[4][4] = (bool (*)[4][4])getShape(choice_names[random]);
-        duplicateBase(*shape, temp.base);
-        temp.type = choice_names[random];
-        temp.y = 20;
-        temp.x = 3;
-
-        selection[length] = temp;
-
-        int i;
-        for (i = random; i < 7; i++) {
-            choice_names[i] = choice_names[i + 1];
-        }
-    }
+void drawShape(SDL_Renderer *renderer, int type, int rotation, struct pos pos, SDL_Colour col) {
+    const struct offset *cells = SHAPES[type][rotation].cells;
     int i;
-    for (i = 0; i < 7; i++) {
-        upcoming[from + i] = selection[i];
+    for (i = 0; i < 4; i++) {
+        drawBlock(renderer, (struct pos) {pos.x + cells[i].x*SQUARE_SIZE, pos.y + cells[i].y*SQUARE_SIZE}, col);
     }
 }
 
-struct pos rotationPoint(char type) {
-    switch(type) {
-        case 'I':
-            return BLOCK_ROTATIONS.I;
-        case 'T':
-            return BLOCK_ROTATIONS.T;
-        case 'L':
-            return BLOCK_ROTATIONS.L;
-        case 'J':
-            return BLOCK_ROTATIONS.J;
-        case 'S':
-            return BLOCK_ROTATIONS.S;
-        case 'Z':
-            return BLOCK_ROTATIONS.Z;
-        case 'O':
-            return BLOCK_ROTATIONS.O;
-        default:         
-            return (struct pos) {1.5, 1.5};
+//the key an SDL key stands for, or -1 if it isn't used
+int gameKey(SDL_Keycode sym) {
+    switch (sym) {
+        case SDLK_UP:
+            return KEY_ROTC;
+        case SDLK_DOWN:
+            return KEY_SDROP;
+        case SDLK_LEFT:
+            return KEY_LEFT;
+        case SDLK_RIGHT:
+            return KEY_RIGHT;
+        case SDLK_RETURN:
+            return KEY_ENTER;
+        case SDLK_SPACE:
+            return KEY_HDROP;
+        case SDLK_z:
+            return KEY_ROTA;
+        case SDLK_x:
+            return KEY_ROT180;
+        case SDLK_RSHIFT:
+            return KEY_HOLD;
+        case SDLK_ESCAPE:
+            return KEY_QUIT;
+        default:
+            return -1;
     }
 }
 
-struct presses updatePressed (struct presses *pressed) {
+//keeps what's held down in pressed and returns what went down since the last call
+//while a game is on, every key going down or up is also queued on ticker with the time SDL got it,
+//so the logic ticks see each one in order even if several happen in one frame
+//F3 isn't part of the game, it just flips show_overlay
+struct presses updatePressed (struct presses *pressed, struct ticker *ticker, bool *show_overlay) {
     SDL_Event e;
     struct presses just_pressed = presses_default;
     while (SDL_PollEvent(&e)) {
         switch (e.type) {
             case SDL_KEYDOWN:
-                if (e.key.repeat == 0) {
-                    switch (e.key.keysym.sym) {
-                        case SDLK_UP:
-                            pressed->rotc = true;
-                            just_pressed.rotc = true;
-                            break;
-                        case SDLK_DOWN:
-                            pressed->sdrop = true;
-                            just_pressed.sdrop = true;
-                            break;
-                        case SDLK_LEFT:
-                            pressed->left = true;
-                            just_pressed.left = true;
-                            break;
-                        case SDLK_RIGHT:
-                            pressed->right = true;
-                            just_pressed.right = true;
-                            break;
-                        case SDLK_RETURN:
-                            pressed->enter = true;
-                            just_pressed.enter = true;
-                            break;
-                        case SDLK_SPACE:
-                            pressed->hdrop = true;
-                            just_pressed.hdrop = true;
-                            break;
-                        case SDLK_z:
-                            pressed->rota = true;
-                            just_pressed.rota = true;
-                            break;
-                        case SDLK_x:
-                            pressed->rot180 = true;
-                            just_pressed.rot180 = true;
-                            break;
-                        case SDLK_RSHIFT:
-                            pressed->hold = true;
-                            just_pressed.hold = true;
-                            break;
-                        case SDLK_ESCAPE:
-                            pressed->quit = true;
-                            just_pressed.quit = true;
-                            break;
-                    }
-                }
-                break;
             case SDL_KEYUP:
-                if (e.key.repeat == 0) {
-                    switch (e.key.keysym.sym) {
-                        case SDLK_UP:
-                            pressed->rotc = false;
-                            break;
-                        case SDLK_DOWN:
-                            pressed->sdrop = false;
-                            break;
-                        case SDLK_LEFT:
-                            pressed->left = false;
-                            break;
-                        case SDLK_RIGHT:
-                            pressed->right = false;
-                            break;
-                        case SDLK_KP_ENTER:
-                            pressed->enter = false;
-                            break;
-                        case SDLK_SPACE:
-                            pressed->hdrop = false;
-                            break;
-                        case SDLK_z:
-                            pressed->rota = false;
-                            break;
-                        case SDLK_x:
-                            pressed->rot180 = false;
-                            break;
-                        case SDLK_RSHIFT:
-                            pressed->hold = false;
-                            break;
-                        case SDLK_ESCAPE:
-                            pressed->quit = false;
-                            break;
+                if (e.type == SDL_KEYDOWN && e.key.repeat == 0 && e.key.keysym.sym == SDLK_F3) {
+                    *show_overlay = !*show_overlay;
+                }
+                if (e.key.repeat == 0 && gameKey(e.key.keysym.sym) >= 0) {
+                    int key = gameKey(e.key.keysym.sym);
+                    bool down = e.type == SDL_KEYDOWN;
+                    *pressesKey(pressed, key) = down;
+                    if (down) {
+                        *pressesKey(&just_pressed, key) = true;
+                    }
+                    //if the ticker won't take the key, go straight to what's held so it can't be left down
+                    if (ticker != NULL && !tickerPush(ticker, (struct key_event) {e.key.timestamp / 1000.0, key, down})) {
+                        ticker->pressed = *pressed;
                     }
                 }
                 break;
+            //whatever was drawn into textures is gone
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+                invalidateLayers();
+                break;
             case SDL_QUIT:
                 pressed->quit = true;
                 just_pressed.quit = true;
@@ -459,72 +489,7 @@ struct presses updatePressed (struct presses *pressed) {
     return just_pressed;
 }
 
-void clearShape(bool piece[4][4]) {
-    int i, j;
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 4; j++) {
-            piece[i][j] = false;
-        }
-    }
-}
-
-void rotateShape(bool base[4][4], char type, bool new_shape[4][4], signed int amount) {
-    clearShape(new_shape);
-    struct pos rot_point = rotationPoint(type);
-    amount = amount % 4;
-    int i, j;
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 4; j++) {
-            if (base[i][j]) {
-                float y = i + 0.5 - rot_point.y;
-                float x = j + 0.5 - rot_point.x;
-                switch (amount) {
-                    case 0:
-                        new_shape[(int)(rot_point.y + y - 0.5)][(int)(rot_point.x + x - 0.5)] = true;
-                        break;
-                    case 1:
-                        new_shape[(int)(rot_point.y + x - 0.5)][(int)(rot_point.x - y - 0.5)] = true;
-                        break;
-                    case 2:
-                        new_shape[(int)(rot_point.y - y - 0.5)][(int)(rot_point.x - x - 0.5)] = true;
-                        break;
-                    case 3:
-                        new_shape[(int)(rot_point.y - x - 0.5)][(int)(rot_point.x + y - 0.5)] = true;
-                        break;
-                }
-            }
-        }
-    }
-}
-
-bool newCurrent(struct tetromino upcoming[], struct tetromino *current, struct block matrix[40][10]) {
-    static int count = 0;
-    count += 1;
-    duplicateBase(upcoming[0].base, current->base);
-    current->y = upcoming[0].y;
-    current->x = upcoming[0].x;
-    current->type = upcoming[0].type;
-    int i;
-    for (i = 1; i < 14; i++) {
-        upcoming[i-1] = upcoming[i];
-    }
-    if (count == 7) {
-        count = 0;
-        extendUpcoming(upcoming, 7);
-    }
-    return !collides(matrix, current->base, (struct pos) {current->x, current->y});
-}
-
-SDL_Texture* loadTexture(SDL_Renderer *renderer, const char *path) {
-    SDL_Surface *surface = IMG_Load(path);
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-
-    SDL_FreeSurface(surface);
-    
-    return texture;
-}
-
-void renderTexture(SDL_Texture *texture, SDL_Renderer *renderer, int x, int y, int w, int h){
+void renderTexture(SDL_Texture *texture, const SDL_Rect *source, SDL_Renderer *renderer, int x, int y, int w, int h){
 	//Setup the destination rectangle to be at the position we want
 
 	SDL_Rect dst;
@@ -534,7 +499,7 @@ void renderTexture(SDL_Texture *texture, SDL_Renderer *renderer, int x, int y, i
     dst.h = h;
 	//Query the texture to get its width and height to use
 
-	SDL_RenderCopy(renderer, texture, NULL, &dst);
+	SDL_RenderCopy(renderer, texture, source, &dst);
 }
 
 void clearScreen(SDL_Renderer *renderer, SDL_Colour col) {
@@ -543,366 +508,360 @@ void clearScreen(SDL_Renderer *renderer, SDL_Colour col) {
 }
 
 void render(SDL_Renderer *renderer) {
+    TRACE_ZONE("render");
     SDL_RenderPresent(renderer);
 }
 
+SDL_Rect packedRect(struct packed_rect rect) {
+    return (SDL_Rect) {rect.x, rect.y, rect.w, rect.h};
+}
+
+//points atlas at font's glyphs in the packed texture
+void loadAtlas(SDL_Texture *texture, const struct packed_font *font, struct glyph_atlas *atlas) {
+    atlas->texture = texture;
+    int i;
+    for (i = 0; i < GLYPH_COUNT; i++) {
+        atlas->glyphs[i] = packedRect(font->glyphs[i]);
+        atlas->advances[i] = font->advances[i];
+    }
+}
+
+//one upload of the atlas tetris-pack built, there's nothing to read from disk or decode
 void preloadAssets(SDL_Renderer *renderer) {
-    assets.logo = loadTexture(renderer, "logo.png");
-    assets.play_button = loadTexture(renderer, "play button.png");
-    assets.end = loadTexture(renderer, "end screen.png");
-    assets.font = TTF_OpenFont("Roboto-Regular.ttf", 40*WINDOW_HEIGHT/600);
-}
-
-void drawText(SDL_Renderer *renderer, TTF_Font *font, char text[], SDL_Colour col, struct pos pos) {
-    SDL_Surface *text_surface = TTF_RenderText_Solid(font, text, col);
-    SDL_Texture *text_texture = SDL_CreateTextureFromSurface(renderer, text_surface);
-    SDL_Rect target;
-    target.x = pos.x;
-    target.y = pos.y;
-    SDL_QueryTexture(text_texture, NULL, NULL, &target.w, &target.h);
-    SDL_FreeSurface(text_surface);
-    SDL_RenderCopy(renderer, text_texture, NULL, &target);
-    SDL_DestroyTexture(text_texture);
-}
-
-void initGame(struct game_data *data, double elapsed_time) {
-    extendUpcoming(data->upcoming, 0);
-    extendUpcoming(data->upcoming, 7);
-    newCurrent(data->upcoming, &(data->current), data->matrix);
-    data->level = 1;
-    emptyMatrix(data->matrix);
-    data->score = 0;
-    data->last_drop = elapsed_time;
-    data->locking = false;
-    data->started_locking = elapsed_time;
-    data->holding = false;
-    data->has_been_held = false;
-    data->lines = 0;
-}
-
-void drawGhost(SDL_Renderer *renderer, struct block matrix[40][10], struct tetromino piece, struct pos board_pos) {
+    TRACE_ZONE("preloadAssets");
+    assets.atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, PACKED_WIDTH, packed_height);
+    if (assets.atlas == NULL || SDL_UpdateTexture(assets.atlas, NULL, packed_pixels, PACKED_WIDTH * 4) != 0) {
+        printf("couldn't load the assets: %s\n", SDL_GetError());
+    }
+    SDL_SetTextureBlendMode(assets.atlas, SDL_BLENDMODE_BLEND);
+    assets.logo = packedRect(packed_images[PACKED_LOGO]);
+    assets.play_button = packedRect(packed_images[PACKED_PLAY_BUTTON]);
+    assets.end = packedRect(packed_images[PACKED_END]);
+    loadAtlas(assets.atlas, &packed_fonts[PACKED_FONT], &assets.font_atlas);
+    loadAtlas(assets.atlas, &packed_fonts[PACKED_SMALL_FONT], &assets.small_atlas);
+}
+
+//sets text up to draw string, unless it's already set up to draw the same thing
+void layoutText(struct text *text, struct glyph_atlas *atlas, const char string[], SDL_Colour col, struct pos pos) {
+    col.a = 255;
+    if (text->atlas == atlas && text->x == pos.x && text->y == pos.y && text->col.r == col.r && text->col.g == col.g
+        && text->col.b == col.b && strncmp(text->string, string, TEXT_LENGTH) == 0) {
+        return;
+    }
+    snprintf(text->string, TEXT_LENGTH, "%s", string);
+    text->atlas = atlas;
+    text->col = col;
+    text->x = pos.x;
+    text->y = pos.y;
+    text->count = 0;
+    int x = pos.x;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    const int quad[6] = {0, 1, 2, 0, 2, 3};
+    int width = 1;
+    int height = 1;
+    SDL_QueryTexture(atlas->texture, NULL, NULL, &width, &height);
+    int j;
+#endif
+    int i;
+    for (i = 0; text->string[i] != '\0'; i++) {
+        int glyph = (unsigned char) text->string[i] - GLYPH_FIRST;
+        if (glyph < 0 || glyph >= GLYPH_COUNT) {
+            glyph = '?' - GLYPH_FIRST;
+        }
+        SDL_Rect source = atlas->glyphs[glyph];
+        SDL_Rect target = {x, pos.y, source.w, source.h};
+        x = x + atlas->advances[glyph];
+        if (source.w == 0) {
+            continue;
+        }
+        text->sources[text->count] = source;
+        text->targets[text->count] = target;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        SDL_FPoint corners[4] = {{target.x, target.y}, {target.x + target.w, target.y}, {target.x + target.w, target.y + target.h}, {target.x, target.y + target.h}};
+        SDL_FPoint uvs[4] = {{source.x / (float) width, source.y / (float) height}, {(source.x + source.w) / (float) width, source.y / (float) height},
+                             {(source.x + source.w) / (float) width, (source.y + source.h) / (float) height}, {source.x / (float) width, (source.y + source.h) / (float) height}};
+        for (j = 0; j < 4; j++) {
+            text->vertices[text->count*4 + j] = (SDL_Vertex) {corners[j], col, uvs[j]};
+        }
+        for (j = 0; j < 6; j++) {
+            text->indices[text->count*6 + j] = text->count*4 + quad[j];
+        }
+#endif
+        text->count = text->count + 1;
+    }
+}
+
+void drawLaidOut(SDL_Renderer *renderer, struct text *text) {
+    TRACE_ZONE("drawText");
+    if (text->count == 0 || text->atlas->texture == NULL) {
+        return;
+    }
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    //the colour is in the vertices
+    SDL_SetTextureColorMod(text->atlas->texture, 255, 255, 255);
+    if (!batch.no_geometry && SDL_RenderGeometry(renderer, text->atlas->texture, text->vertices, text->count*4, text->indices, text->count*6) == 0) {
+        return;
+    }
+#endif
+    SDL_SetTextureColorMod(text->atlas->texture, text->col.r, text->col.g, text->col.b);
+    int i;
+    for (i = 0; i < text->count; i++) {
+        SDL_RenderCopy(renderer, text->atlas->texture, &text->sources[i], &text->targets[i]);
+    }
+    //the images are in the same texture
+    SDL_SetTextureColorMod(text->atlas->texture, 255, 255, 255);
+}
+
+//for text that changes every time it's drawn, laid out in the frame's scratch memory
+void drawText(SDL_Renderer *renderer, struct glyph_atlas *atlas, const char text[], SDL_Colour col, struct pos pos) {
+    struct text *laid_out = arenaAlloc(&frame_arena, sizeof(struct text));
+    if (laid_out == NULL) {
+        return;
+    }
+    laid_out->atlas = NULL;
+    layoutText(laid_out, atlas, text, col, pos);
+    drawLaidOut(renderer, laid_out);
+}
+
+void drawGhost(SDL_Renderer *renderer, struct board *matrix, struct tetromino piece, struct pos board_pos) {
     int offset = getDroppedPos(matrix, piece);
-    SDL_Colour col = getBlockColour(piece.type);
+    SDL_Colour col = getBlockColour(names[piece.type]);
     col.r = col.r/2;
     col.g = col.g/2;
     col.b = col.b/2;
-    int i, j;
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 4; j++) {
-            if (piece.base[i][j]) {
-                drawBlock(renderer, (struct pos) {board_pos.x + piece.x*SQUARE_SIZE + j*SQUARE_SIZE, board_pos.y + (19-piece.y+offset)*SQUARE_SIZE + i*SQUARE_SIZE}, col);
-            }
-        }
-    }
+    drawShape(renderer, piece.type, piece.rotation, (struct pos) {board_pos.x + piece.x*SQUARE_SIZE, board_pos.y + (19-piece.y+offset)*SQUARE_SIZE}, col);
 }
 
-void drawUpcoming(SDL_Renderer *renderer, struct tetromino upcoming[14], struct pos board_pos) {
+void drawUpcoming(SDL_Renderer *renderer, int upcoming[5], struct pos board_pos) {
     board_pos.x = board_pos.x + 11*SQUARE_SIZE;
     board_pos.y = board_pos.y + SQUARE_SIZE;
     int i;
     for (i = 0; i < 5; i++) {
-        drawShape(renderer, upcoming[i].base, board_pos, getBlockColour(upcoming[i].type));
+        drawShape(renderer, upcoming[i], 0, board_pos, getBlockColour(names[upcoming[i]]));
         board_pos.y = board_pos.y + SQUARE_SIZE*4;
     }
 }
 
 void drawGameText(SDL_Renderer *renderer, int level, int score, struct pos board_pos) {
-    int length = snprintf( NULL, 0, "%d", level);
-    char* level_str = malloc( length + 1 );
-    snprintf( level_str, length + 1, "%d", level);
-    drawText(renderer, assets.font, level_str, (SDL_Colour) {0, 0, 0, 0}, (struct pos) {board_pos.x - SQUARE_SIZE*4, board_pos.y + SQUARE_SIZE*4});
-
-    length = snprintf( NULL, 0, "%d", score);
-    char* score_str = malloc( length + 1 );
-    snprintf( score_str, length + 1, "%d", score);
-    drawText(renderer, assets.font, score_str, (SDL_Colour) {0, 0, 0, 0}, (struct pos) {board_pos.x + SQUARE_SIZE, board_pos.y - 50*WINDOW_HEIGHT/600});
-    
+    char string[16];
+    snprintf(string, sizeof(string), "%d", level);
+    layoutText(&level_text, &assets.font_atlas, string, (SDL_Colour) {0, 0, 0, 255}, (struct pos) {board_pos.x - SQUARE_SIZE*4, board_pos.y + SQUARE_SIZE*4});
+    drawLaidOut(renderer, &level_text);
+
+    snprintf(string, sizeof(string), "%d", score);
+    layoutText(&score_text, &assets.font_atlas, string, (SDL_Colour) {0, 0, 0, 255}, (struct pos) {board_pos.x + SQUARE_SIZE, board_pos.y - 50*WINDOW_HEIGHT/600});
+    drawLaidOut(renderer, &score_text);
 }
 
-void drawGame(SDL_Renderer *renderer, struct block matrix[40][10], struct tetromino current, struct tetromino upcoming[14], bool holding, struct tetromino held_piece, int score, int level) {
+void drawGame(SDL_Renderer *renderer, struct board *matrix, int board_version, struct tetromino current, int upcoming[5], bool holding, struct tetromino held_piece, int score, int level) {
+    Uint64 since = SDL_GetPerformanceCounter();
     struct pos board_pos = {WINDOW_WIDTH/2-SQUARE_SIZE*5, WINDOW_HEIGHT/2-SQUARE_SIZE*10};
-    drawBoard(renderer, board_pos, SQUARE_SIZE);
-    drawMatrix(renderer, matrix, board_pos);
+    drawBoardLayer(renderer, matrix, board_version, board_pos);
+    timePhase(PHASE_DRAW_BOARD, &since);
     drawGhost(renderer, matrix, current, board_pos);
-    drawShape(renderer, current.base, (struct pos) {board_pos.x + current.x*SQUARE_SIZE, board_pos.y + (19-current.y)*SQUARE_SIZE}, getBlockColour(current.type));
+    batchLayer();
+    drawShape(renderer, current.type, current.rotation, (struct pos) {board_pos.x + current.x*SQUARE_SIZE, board_pos.y + (19-current.y)*SQUARE_SIZE}, getBlockColour(names[current.type]));
     drawUpcoming(renderer, upcoming, board_pos);
     if (holding) {
-        drawShape(renderer, held_piece.base, (struct pos) {board_pos.x - 5*SQUARE_SIZE, board_pos.y + SQUARE_SIZE}, getBlockColour(held_piece.type));
+        drawShape(renderer, held_piece.type, held_piece.rotation, (struct pos) {board_pos.x - 5*SQUARE_SIZE, board_pos.y + SQUARE_SIZE}, getBlockColour(names[held_piece.type]));
     }
+    //the board and pieces all go to the renderer here
+    flushBatch(renderer);
+    timePhase(PHASE_DRAW_PIECES, &since);
     drawGameText(renderer, level, score, board_pos);
+    timePhase(PHASE_DRAW_TEXT, &since);
 }
 
-bool tryDrop(int level, struct tetromino *current, struct block matrix[40][10], double *last_drop, double elapsed_time, bool sdrop) {
-    float gravity;
-    if (!sdrop) {
-        gravity = pow((0.8-((level-1)*0.007)), (level-1));
-    } else {
-        gravity = SDROP_GRAVITY;
+//bot is NULL when a person is playing, recorder is NULL when the game isn't being recorded
+//the bot searches on its own thread, so a frame only ever starts a search or plays the move from one that's finished
+enum states gameRun(SDL_Renderer *renderer, struct game_data *data, struct ticker *ticker, struct bot_runner *bot, struct recorder *recorder, double now) {
+    Uint64 since = SDL_GetPerformanceCounter();
+    if (bot != NULL) {
+        botTurnInBackground(bot, data);
     }
-    if (elapsed_time > *last_drop + gravity) {
-        *last_drop = elapsed_time;
-
-        if (!collides(matrix, current->base, (struct pos) {current->x, current->y - 1})) {
-            current->y = current->y - 1;
-        } else {
-            return false;
+    //the logic runs in fixed ticks so handling is just as exact at any frame rate, and the frame draws wherever it got to
+    tickerAdvance(ticker, now);
+    struct inputs inputs;
+    bool playing = true;
+    while (playing && tickerNext(ticker, &inputs)) {
+        if (bot != NULL) {
+            inputs = (struct inputs) {presses_default, presses_default};
         }
+        playing = recorder != NULL ? recordStep(recorder, data, inputs, 1.0 / TICK_RATE) : gameStep(data, inputs, 1.0 / TICK_RATE);
     }
-    return true;
-}
-
-bool overflows(struct tetromino piece) {
-    bool result = true;
-    int i, j;
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 4; j++) {
-            if (piece.base[i][j]) {
-                if (i < 20) {
-                    result = false;
-                }
-            }
-        }
+    timePhase(PHASE_LOGIC, &since);
+    if (!playing) {
+        return END_STATE;
     }
-    return result;
-}
 
-int getDASsedPos(struct block matrix[40][10], struct tetromino piece, int direction) {
-    int move = 0;
-    while (true) {
-        if (collides(matrix, piece.base, (struct pos) {piece.x + move, piece.y})) {
-            return piece.x + move - direction;
-        }
-        move = move + direction;
+    int upcoming[5];
+    int i;
+    for (i = 0; i < 5; i++) {
+        upcoming[i] = upcomingPiece(data, i);
     }
+    drawGame(renderer, &data->matrix, data->board_version, data->current, upcoming, data->holding, data->hold_piece, data->score, data->level);
+    timePhase(PHASE_DRAW, &since);
+
+    return GAME_STATE;
 }
 
-bool lockPiece(struct tetromino *piece, struct block matrix[40][10], struct tetromino upcoming[14], bool *has_been_held) {
-    *has_been_held = false;
-    int i, j;
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 4; j++) {
-            if (piece->base[i][j]) {
-                matrix[piece->y - i][piece->x + j].exists = true;
-                matrix[piece->y - i][piece->x + j].col = getBlockColour(piece->type);
-            }
-        }
+//draws a screen that never changes, from its layer after the first time
+void drawScreen(SDL_Renderer *renderer, enum states state, void (*draw)(SDL_Renderer *renderer)) {
+    if (layers.screens[state] == NULL) {
+        draw(renderer);
+        return;
     }
-    if (overflows(*piece)) {
-        return false;
-    }
-    if (!newCurrent(upcoming, piece, matrix)) {
-        return false;
+    if (!layers.screens_drawn[state]) {
+        SDL_SetRenderTarget(renderer, layers.screens[state]);
+        clearScreen(renderer, (SDL_Colour) {255, 255, 255, 255});
+        draw(renderer);
+        SDL_SetRenderTarget(renderer, NULL);
+        layers.screens_drawn[state] = true;
     }
-    return true;
+    SDL_RenderCopy(renderer, layers.screens[state], NULL, NULL);
 }
 
-bool gameKeyboardHandling(struct game_data *data, struct presses pressed, struct presses just_pressed, double elapsed_time) {
-    if (pressed.left) {
-        if (elapsed_time > data->left_das + DAS) {
-            if (ARR == 0) {
-                data->current.x = getDASsedPos(data->matrix, data->current, -1);
-            }
-            else if (elapsed_time > data->last_das_move + ARR) {
-                if(!collides(data->matrix, data->current.base, (struct pos) {data->current.x - 1, data->current.y})) {
-                    data->current.x = data->current.x - 1;
-                    data->last_das_move = elapsed_time;
-                }
-            }
-        } else {
-            data->last_das_move = elapsed_time;
-        }
-    } else {
-        data->left_das = elapsed_time;
-    }
-
-    if (pressed.right) {
-        if (elapsed_time > data->right_das + DAS) {
-            if (ARR == 0) {
-                data->current.x = getDASsedPos(data->matrix, data->current, 1);
-            }
-            else if (elapsed_time > data->last_das_move + ARR) {
-                if(!collides(data->matrix, data->current.base, (struct pos) {data->current.x + 1, data->current.y})) {
-                    data->current.x = data->current.x + 1;
-                    data->last_das_move = elapsed_time;
-                }
-            }
-        } else {
-            data->last_das_move = elapsed_time;
-        }
-    } else {
-        data->right_das = elapsed_time;
-    }
+void drawMenu(SDL_Renderer *renderer) {
+    renderTexture(assets.atlas, &assets.logo, renderer, WINDOW_WIDTH/4, WINDOW_HEIGHT/6, LOGO_WIDTH, LOGO_HEIGHT);
+    renderTexture(assets.atlas, &assets.play_button, renderer, WINDOW_WIDTH/3, WINDOW_HEIGHT/6 + LOGO_HEIGHT*0.8, PLAY_BUTTON_WIDTH, PLAY_BUTTON_HEIGHT);
+}
 
-    if (just_pressed.left) {
-        if (!collides(data->matrix, data->current.base, (struct pos) {data->current.x - 1, data->current.y})) {
-            data->current.x = data->current.x - 1;
-            data->locking = false;
-        }
-    }
+void drawEnd(SDL_Renderer *renderer) {
+    renderTexture(assets.atlas, &assets.end, renderer, 0, 0, END_WIDTH, END_HEIGHT);
+}
 
-    if (just_pressed.right) {
-        if (!collides(data->matrix, data->current.base, (struct pos) {data->current.x + 1, data->current.y})) {
-            data->current.x = data->current.x + 1;
-            data->locking = false;
-        }
+enum states menuRun(SDL_Renderer *renderer, struct presses pressed) {
+    drawScreen(renderer, MENU_STATE, drawMenu);
+    if (pressed.enter) {
+        return GAME_STATE;
     }
+    return MENU_STATE;
+}
 
-    if (just_pressed.rotc || just_pressed.rota || just_pressed.rot180) {
-        int amount = 0;
-        if (just_pressed.rotc) {
-            amount = 1;
-        } else if (just_pressed.rota) {
-            amount = 3;
-        } else if (just_pressed.rot180) {
-            amount = 2;
-        }
-        bool new_shape[4][4];
-        rotateShape(data->current.base, data->current.type, new_shape, amount);
-        if (!collides(data->matrix, new_shape, (struct pos) {data->current.x, data->current.y})) {
-            duplicateBase(new_shape, data->current.base);
-            data->locking = false;
-        }
+enum states endRun(SDL_Renderer *renderer, struct presses pressed, int score) {
+    drawScreen(renderer, END_STATE, drawEnd);
+    if (pressed.enter) {
+        return MENU_STATE;
     }
+    return END_STATE;
+}
 
-    if (just_pressed.hdrop) {
-        data->current.y = data->current.y - getDroppedPos(data->matrix, data->current);
-        if (!lockPiece(&data->current, data->matrix, data->upcoming, &data->has_been_held)) {
-            return false;
-        }
-        data->locking = false;
+//sleeps most of the way to deadline, a performance counter value, and spins the rest for a precise wake up
+void waitUntil(Uint64 deadline) {
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 now = SDL_GetPerformanceCounter();
+    while (now < deadline && (deadline - now) * 1000 / frequency > PACING_SPIN_MS) {
+        SDL_Delay((deadline - now) * 1000 / frequency - PACING_SPIN_MS);
+        now = SDL_GetPerformanceCounter();
     }
-
-    if (just_pressed.hold && !data->has_been_held) {
-        if (!data->holding) {
-            data->holding = true;
-            data->locking = false;
-            data->hold_piece = data->current;
-            if (!newCurrent(data->upcoming, &data->current, data->matrix)) {
-                return false;
-            }
-        } else {
-            data->locking = false;
-            struct tetromino temp = data->current;
-            data->current = data->hold_piece;
-            data->hold_piece = temp;
-        }
-        data->hold_piece.x = 3;
-        data->hold_piece.y = 20;
-        duplicateBase((bool (*)[4]) *getShape(data->hold_piece.type), data->hold_piece.base);
-        data->has_been_held = true;
+    while (now < deadline) {
+        now = SDL_GetPerformanceCounter();
     }
-    return true;
 }
 
-bool gameGravity(struct game_data *data, struct presses pressed, double elapsed_time) {
-    tryDrop(data->level, &data->current, data->matrix, &data->last_drop, elapsed_time, pressed.sdrop);
-
-    if (collides(data->matrix, data->current.base, (struct pos) {data->current.x, data->current.y - 1})) {
-        if (data->locking) {
-            if (elapsed_time > data->started_locking + LOCK_DELAY) {
-                if (!lockPiece(&data->current, data->matrix, data->upcoming, &data->has_been_held)) {
-                    return false;
-                }
-                data->locking = false;
-            }
-        } else {
-            data->locking = true;
-            data->started_locking = elapsed_time;
-        }
-    } else {
-        data->locking = false;
+//frame times so far, toggled with F3
+void drawOverlay(SDL_Renderer *renderer, enum pacing pacing, int refresh_rate) {
+    struct histogram *frame = &frame_stats.phases[PHASE_FRAME];
+    char lines[6][128];
+    snprintf(lines[0], sizeof(lines[0]), "frame p50 %.1f p99 %.1f max %.1f ms", histogramPercentile(frame, 0.5) / 1000.0,
+             histogramPercentile(frame, 0.99) / 1000.0, frame->max / 1000.0);
+    snprintf(lines[1], sizeof(lines[1]), "dropped %ld of %ld frames, %s at %d Hz, jitter p99 %.2f max %.2f ms", frame_stats.dropped, frame_stats.frames,
+             pacing_names[pacing], refresh_rate, histogramPercentile(&frame_stats.jitter, 0.99) / 1000.0, frame_stats.jitter.max / 1000.0);
+    snprintf(lines[2], sizeof(lines[2]), "p99 input %.2f logic %.2f draw %.2f present %.2f ms",
+             histogramPercentile(&frame_stats.phases[PHASE_INPUT], 0.99) / 1000.0, histogramPercentile(&frame_stats.phases[PHASE_LOGIC], 0.99) / 1000.0,
+             histogramPercentile(&frame_stats.phases[PHASE_DRAW], 0.99) / 1000.0, histogramPercentile(&frame_stats.phases[PHASE_PRESENT], 0.99) / 1000.0);
+    snprintf(lines[3], sizeof(lines[3]), "p99 board %.2f pieces %.2f text %.2f ms",
+             histogramPercentile(&frame_stats.phases[PHASE_DRAW_BOARD], 0.99) / 1000.0, histogramPercentile(&frame_stats.phases[PHASE_DRAW_PIECES], 0.99) / 1000.0,
+             histogramPercentile(&frame_stats.phases[PHASE_DRAW_TEXT], 0.99) / 1000.0);
+    int count = 4;
+    if (allocations.counting) {
+        snprintf(lines[4], sizeof(lines[4]), "allocations last frame %ld, scratch %zu bytes", allocations.last_frame, frame_arena.peak);
+        count = 5;
+    }
+    int i;
+    for (i = 0; i < count; i++) {
+        drawText(renderer, &assets.small_atlas, lines[i], (SDL_Colour) {0, 0, 0, 255}, (struct pos) {5, 5 + i*18*WINDOW_HEIGHT/600});
     }
-    return true;
 }
 
-int fullLineCount(struct block matrix[40][10]) {
-    int count = 0;
-    int i, j;
-    for (i = 0; i < 40; i++) {
-        bool full = true;
-        for (j = 0; j < 10; j++) {
-            if (!matrix[i][j].exists) {
-                full = false;
-            }
-        }
-        if (full) {
-            count = count + 1;
-        }
-    }
-    return count;
+void printBotStats(struct bot *bot, struct game_data *data) {
+    printf("bot placed %ld pieces in %.1f s, %.1f pieces/sec\n", bot->stats.pieces, data->time, bot->stats.pieces / data->time);
+    printf("bot searched %ld boards in %.3f s of thinking, %.1f nodes/sec\n", bot->stats.nodes, bot->stats.thinking, bot->stats.nodes / bot->stats.thinking);
+    printf("bot found %.1f%% of boards in its transposition table and skipped %ld repeated positions\n", 100.0 * bot->stats.hits / bot->stats.nodes, bot->stats.duplicates);
 }
 
-//hopefully line 40 will always be clear
-void clearLine(struct block matrix[40][10], int line) {
-    int i, j;
-    for (i = line; i < 39; i++) {
-        for (j = 0; j < 10; j++) {
-            matrix[i][j] = matrix[i + 1][j];
-        }
+//starts recording a game into a new file in directory, returns false if it can't
+bool startReplay(struct recorder *recorder, const char *directory, struct game_data *data, uint64_t seed) {
+    char path[4096];
+    mkdir(directory, 0755);
+    if (!startNewRecording(recorder, directory, data, seed, path, sizeof(path))) {
+        printf("couldn't record the game in %s\n", directory);
+        return false;
     }
+    return true;
 }
 
-void clearLines(struct block matrix[40][10]) {
-    int i, j;
-    for (i = 39; i > -1; i--) {
-        bool full = true;
-        for (j = 0; j < 10; j++) {
-            if (!matrix[i][j].exists) {
-                full = false;
+int main(int argc, char *argv[]) {
+    //-b lets the bot play, optionally followed by its options, e.g. -b pps=3,threads=4
+    //-r sets the directory games are recorded in, or turns recording off if it's empty
+    //-s sets the file frame timings are written to on exit, or turns that off if it's empty
+    //-p picks the frame pacing, vsync, uncapped or hybrid
+    //--20g makes pieces fall straight to the stack at every level
+    //--alloc-check counts heap allocations made by SDL and the game each frame, and exits with 1 if any frame made one once warmed up
+    bool bot_playing = false;
+    const char *replay_directory = "replays";
+    const char *stats_path = "frame_stats.csv";
+    bool alloc_check = false;
+    bool instant_gravity = false;
+    enum pacing pacing = PACING_HYBRID;
+    struct bot_options bot_options = default_bot_options;
+    bot_options.pps = 2;
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0) {
+            bot_playing = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                parseBotOptions(argv[i + 1], &bot_options);
+                i = i + 1;
             }
-        }
-        if (full) {
-            clearLine(matrix, i);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            replay_directory = argv[i + 1];
+            i = i + 1;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            stats_path = argv[i + 1];
+            i = i + 1;
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            for (pacing = 0; pacing < PACINGS && strcmp(argv[i + 1], pacing_names[pacing]) != 0; pacing++) {
+            }
+            if (pacing == PACINGS) {
+                printf("pacing has to be vsync, uncapped or hybrid\n");
+                return 1;
+            }
+            i = i + 1;
+        } else if (strcmp(argv[i], "--20g") == 0) {
+            instant_gravity = true;
+        } else if (strcmp(argv[i], "--alloc-check") == 0) {
+            alloc_check = true;
+        } else {
+            printf("usage: %s [-b [width=64,depth=6,time=0.05,threads=1,pps=2,tt=16]] [-r replay directory] [-s frame stats file] [-p vsync|uncapped|hybrid] [--20g] [--alloc-check]\n", argv[0]);
+            return 1;
         }
     }
-}
 
-enum states gameRun(SDL_Renderer *renderer, struct game_data *data, struct presses pressed, struct presses just_pressed, double elapsed_time) {
-    if (!gameGravity(data, pressed, elapsed_time)) {
-        return END_STATE;
-    }
-
-    if (!gameKeyboardHandling(data, pressed, just_pressed, elapsed_time)) {
-        return END_STATE;
-    }
-
-    int lines_cleared = fullLineCount(data->matrix);
-    data->score = data->score + scoring[lines_cleared-1]*data->level;
-    data->lines = data->lines + lines_cleared;
-    data->level = (int) data->lines / 10 + 1;
-    clearLines(data->matrix);
-    
-    drawGame(renderer, data->matrix, data->current, data->upcoming, data->holding, data->hold_piece, data->score, data->level);    
-
-    return GAME_STATE;
-}
-
-enum states menuRun(SDL_Renderer *renderer, struct presses pressed) {
-    renderTexture(assets.logo, renderer, WINDOW_WIDTH/4, WINDOW_HEIGHT/6, WINDOW_WIDTH/2, WINDOW_WIDTH/2*795/957);
-    renderTexture(assets.play_button, renderer, WINDOW_WIDTH/3, WINDOW_HEIGHT/6 + WINDOW_WIDTH/2*795/957*0.8, WINDOW_WIDTH/3, WINDOW_WIDTH/3*766/1352);
-    if (pressed.enter) {
-        return GAME_STATE;
+    if (alloc_check) {
+        countAllocations();
     }
-    return MENU_STATE;
-}
-
-enum states endRun(SDL_Renderer *renderer, struct presses pressed, int score) {
-    renderTexture(assets.end, renderer, 0, 0, WINDOW_WIDTH, 1045*WINDOW_WIDTH/2048);
-    if (pressed.enter) {
-        return MENU_STATE;
+    if (!initArena(&frame_arena, FRAME_ARENA_SIZE)) {
+        printf("couldn't allocate %d bytes of frame memory\n", FRAME_ARENA_SIZE);
+        return 1;
     }
-    return END_STATE;
-}
 
-int main() {
     //initialise
     if (SDL_Init(SDL_INIT_VIDEO)!= 0) {
         printf("error initialising SDL: %s\n", SDL_GetError());
         return 1;
     }
 
-    TTF_Init();
-
     //create window and renderer
     SDL_Window * win = SDL_CreateWindow("Tetris", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, WINDOW_HEIGHT, 0);
     if (!win) {
@@ -911,35 +870,70 @@ int main() {
         return 1;
     }
 
-    SDL_Renderer * renderer = SDL_CreateRenderer(win, -1, 0);
+    SDL_Renderer * renderer = SDL_CreateRenderer(win, -1, pacing == PACING_VSYNC ? SDL_RENDERER_PRESENTVSYNC : 0);
     if (!renderer) {
         printf("error creating renderer: %s\n", SDL_GetError());
         SDL_Quit();
         return 1;
     }
 
-    srand(time(NULL) );
-
     preloadAssets(renderer);
-    initTetrominoes();
+    initLayers(renderer);
 
     struct presses pressed = presses_default;
     struct presses just_pressed = presses_default;
     bool exit = false;
     enum states state = MENU_STATE;
-    double elapsed_time;
     struct game_data data;
+    struct ticker ticker;
+    struct bot bot;
+    struct bot_runner runner;
+    struct recorder recorder;
+    bool recording = false;
+    bool show_overlay = false;
+    resetFrameStats(&frame_stats);
+
+    //frames are paced to the display the window is on, or 60 Hz if it doesn't say
+    int refresh_rate = 60;
+    SDL_DisplayMode mode;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(win), &mode) == 0 && mode.refresh_rate > 0) {
+        refresh_rate = mode.refresh_rate;
+    }
+    Uint64 period = SDL_GetPerformanceFrequency() / refresh_rate;
+    Uint64 next_frame = SDL_GetPerformanceCounter();
+    Uint64 last_start = 0;
+
+#ifdef TETRIS_TRACE
+    traceStart(1 << 22);
+#endif
+
+    //frames since the state last changed, and frames that allocated once they were past ALLOC_WARMUP of them
+    int state_frames = 0;
+    long allocating_frames = 0;
+    long most_allocations = 0;
 
     while (!exit) {
-        elapsed_time = SDL_GetPerformanceCounter()/(float)SDL_GetPerformanceFrequency();
-        just_pressed = updatePressed(&pressed);
+        TRACE_ZONE("frame");
+        Uint64 start = SDL_GetPerformanceCounter();
+        Uint64 since = start;
+        if (last_start != 0) {
+            Uint64 interval = start - last_start;
+            Uint64 off = interval > period ? interval - period : period - interval;
+            histogramAdd(&frame_stats.jitter, off * 1000000 / SDL_GetPerformanceFrequency());
+        }
+        last_start = start;
+        resetArena(&frame_arena);
+        long allocations_before = allocations.count;
+        enum states frame_state = state;
+        just_pressed = updatePressed(&pressed, state == GAME_STATE ? &ticker : NULL, &show_overlay);
+        //key event timestamps are SDL ticks, so the logic runs on the same clock
+        double now = SDL_GetTicks() / 1000.0;
+        timePhase(PHASE_INPUT, &since);
 
         if (pressed.quit) {
             exit = true;
         }
 
-        Uint64 start = SDL_GetPerformanceCounter();
-
         clearScreen(renderer, (SDL_Colour) {255, 255, 255, 255});
 
         switch (state) {
@@ -947,34 +941,117 @@ int main() {
             case MENU_STATE:
                 state = menuRun(renderer, just_pressed);
                 if (state == GAME_STATE) {
-                    initGame(&data, elapsed_time);
+                    //the performance counter moves on every few nanoseconds and the pid tells apart instances started together
+                    uint64_t seed = SDL_GetPerformanceCounter() * 0x9E3779B97F4A7C15ULL ^ (uint64_t) getpid() << 32 ^ (uint64_t) time(NULL);
+                    initGame(&data, seed);
+                    if (instant_gravity) {
+                        struct settings settings = data.settings;
+                        settings.instant_gravity = true;
+                        applySettings(&data, settings);
+                    }
+                    //the new board's versions start again from 0
+                    invalidateLayers();
+                    initTicker(&ticker, now);
+                    //keys still held from the menu carry on being held
+                    ticker.pressed = pressed;
+                    if (bot_playing) {
+                        initBot(&bot, bot_options);
+                        initRunner(&runner, &bot);
+                    }
+                    //the bot places pieces without going through the inputs, so only people's games can be replayed
+                    recording = !bot_playing && replay_directory[0] != '\0' && startReplay(&recorder, replay_directory, &data, seed);
                 }
+                timePhase(PHASE_DRAW, &since);
                 break;
             case GAME_STATE:
-                state = gameRun(renderer, &data, pressed, just_pressed, elapsed_time);
+                state = gameRun(renderer, &data, &ticker, bot_playing ? &runner : NULL, recording ? &recorder : NULL, now);
+                if (bot_playing && (state != GAME_STATE || exit)) {
+                    stopRunner(&runner);
+                    printBotStats(&bot, &data);
+                    freeBot(&bot);
+                }
+                if (recording && (state != GAME_STATE || exit)) {
+                    finishRecording(&recorder, &data);
+                    recording = false;
+                }
+                //gameRun times its own logic and drawing
+                since = SDL_GetPerformanceCounter();
                 break;
             case END_STATE:
                 state = endRun(renderer, just_pressed, data.score);
+                timePhase(PHASE_DRAW, &since);
                 break;
         }
 
+        //the overlay is left out of the phases so turning it on doesn't change them, but it's still part of the frame
+        if (show_overlay) {
+            drawOverlay(renderer, pacing, refresh_rate);
+            since = SDL_GetPerformanceCounter();
+        }
+
+        Uint64 presenting = since;
         render(renderer);
+        timePhase(PHASE_PRESENT, &since);
 
         //wait
         Uint64 end = SDL_GetPerformanceCounter();
-        float elapsedMS = (end - start) / (float)SDL_GetPerformanceFrequency() * 1000.0f;
-        if (!(elapsedMS > 16.666f)) {
-            SDL_Delay(floor(16.666f - elapsedMS));
+        //with vsync the wait for the display is part of present, so only the work before it counts
+        Uint64 work = pacing == PACING_VSYNC ? presenting - start : end - start;
+        if (work > period) {
+            frame_stats.dropped = frame_stats.dropped + 1;
+        }
+        if (pacing == PACING_HYBRID) {
+            //frames are due a period apart, starting again from now after one runs late rather than rushing to catch up
+            next_frame = next_frame + period;
+            if (next_frame < end) {
+                next_frame = end;
+            }
+            waitUntil(next_frame);
+        }
+        timePhase(PHASE_SLEEP, &since);
+        timePhase(PHASE_FRAME, &start);
+        frame_stats.frames = frame_stats.frames + 1;
+
+        allocations.last_frame = allocations.count - allocations_before;
+        state_frames = state == frame_state ? state_frames + 1 : 0;
+        if (state_frames > ALLOC_WARMUP && allocations.last_frame > 0) {
+            allocating_frames = allocating_frames + 1;
+            most_allocations = allocations.last_frame > most_allocations ? allocations.last_frame : most_allocations;
+        }
+    }
+
+    if (alloc_check) {
+        if (allocations.counting) {
+            printf("%ld of %ld frames allocated once warmed up, at most %ld times in one frame\n", allocating_frames, frame_stats.frames, most_allocations);
+        } else {
+            printf("couldn't count allocations, SDL's memory functions can't be replaced once it has allocated\n");
+        }
+    }
+
+#ifdef TETRIS_TRACE
+    if (traceFinish("trace.json")) {
+        printf("trace written to trace.json\n");
+    } else {
+        printf("couldn't write trace.json\n");
+    }
+#endif
+
+    if (stats_path[0] != '\0') {
+        FILE *file = fopen(stats_path, "w");
+        if (file == NULL || !writeFrameStats(&frame_stats, file)) {
+            printf("couldn't write frame timings to %s\n", stats_path);
+        }
+        if (file != NULL) {
+            fclose(file);
         }
     }
 
     //destroy window and renderer and uninitialise SDL
-    SDL_DestroyTexture(assets.logo);
-    SDL_DestroyTexture(assets.play_button);
-    TTF_CloseFont(assets.font);
+    freeLayers();
+    SDL_DestroyTexture(assets.atlas);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(win);
-    TTF_Quit();
     SDL_Quit();
-    return 0;
+    freeArena(&frame_arena);
+    return alloc_check && allocating_frames > 0;
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200809L
+#include "trace.h"
+
+#ifdef TETRIS_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//each thread takes the buffer a chunk at a time, so ending a zone doesn't need an atomic
+#define TRACE_CHUNK 4096
+
+struct trace_event {
+    //NULL for the rest of a chunk a thread never filled
+    const char *name;
+    uint64_t start;
+    uint64_t duration;
+    int thread;
+};
+
+struct trace {
+    struct trace_event *events;
+    int chunks;
+    int chunks_taken;
+    int threads;
+    //zones ended after the buffer filled up
+    long dropped;
+    //ticks and nanoseconds when tracing started, to turn ticks into time when writing
+    uint64_t start_ticks;
+    uint64_t start_ns;
+};
+
+struct trace trace = {NULL, 0, 0, 0, 0, 0, 0};
+
+//where the thread's next zone goes and the end of its chunk
+__thread struct trace_event *trace_next = NULL;
+__thread struct trace_event *trace_end = NULL;
+//numbered from 1 as each thread takes its first chunk
+__thread int trace_thread = 0;
+
+uint64_t traceClock(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
+
+bool traceStart(int capacity) {
+    trace.chunks = (capacity + TRACE_CHUNK - 1) / TRACE_CHUNK;
+    trace.events = malloc(sizeof(struct trace_event) * trace.chunks * TRACE_CHUNK);
+    if (trace.events == NULL) {
+        return false;
+    }
+    //touch every page now rather than taking the faults inside zones, and mark every slot unused
+    memset(trace.events, 0, sizeof(struct trace_event) * trace.chunks * TRACE_CHUNK);
+    trace.chunks_taken = 0;
+    trace.dropped = 0;
+    trace.start_ns = traceClock();
+    trace.start_ticks = TRACE_TICKS();
+    return true;
+}
+
+//gives the thread a new chunk, returns false if tracing is off or every chunk is taken
+bool traceChunk(void) {
+    if (trace.events == NULL) {
+        return false;
+    }
+    int chunk = __atomic_fetch_add(&trace.chunks_taken, 1, __ATOMIC_RELAXED);
+    if (chunk >= trace.chunks) {
+        __atomic_add_fetch(&trace.dropped, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    if (trace_thread == 0) {
+        trace_thread = __atomic_add_fetch(&trace.threads, 1, __ATOMIC_RELAXED);
+    }
+    trace_next = &trace.events[chunk * TRACE_CHUNK];
+    trace_end = trace_next + TRACE_CHUNK;
+    return true;
+}
+
+void traceEnd(struct trace_zone *zone) {
+    uint64_t end = TRACE_TICKS();
+    if (trace_next == trace_end && !traceChunk()) {
+        return;
+    }
+    struct trace_event *event = trace_next;
+    trace_next = trace_next + 1;
+    event->name = zone->name;
+    event->start = zone->start;
+    event->duration = end - zone->start;
+    event->thread = trace_thread;
+}
+
+bool traceFinish(const char *path) {
+    if (trace.events == NULL) {
+        return false;
+    }
+    //the ticks run at a steady rate, so the whole run gives how long one is
+    double ns_per_tick = 1;
+    uint64_t ticks = TRACE_TICKS() - trace.start_ticks;
+    if (ticks > 0) {
+        ns_per_tick = (traceClock() - trace.start_ns) / (double) ticks;
+    }
+    int count = (trace.chunks_taken < trace.chunks ? trace.chunks_taken : trace.chunks) * TRACE_CHUNK;
+
+    bool written = false;
+    FILE *file = fopen(path, "w");
+    if (file != NULL) {
+        fprintf(file, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_zones\":\"%ld\"},\"traceEvents\":[\n", trace.dropped);
+        bool first = true;
+        int i;
+        for (i = 0; i < count; i++) {
+            struct trace_event *event = &trace.events[i];
+            if (event->name == NULL) {
+                continue;
+            }
+            //zones are only saved on the way out, so one that started before tracing did is cut off there
+            double start = event->start > trace.start_ticks ? (event->start - trace.start_ticks) * ns_per_tick : 0;
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}\n",
+                    first ? "" : ",", event->name, event->thread, start / 1000, event->duration * ns_per_tick / 1000);
+            first = false;
+        }
+        fprintf(file, "]}\n");
+        written = !ferror(file);
+        written = fclose(file) == 0 && written;
+    }
+    //threads may still hold pointers into the buffer, so it stays, but no more chunks are handed out
+    trace.chunks = 0;
+    return written;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//scoped zones saved as a Chrome trace, which ui.perfetto.dev and chrome://tracing open as a timeline
+//only built in with -DTETRIS_TRACE (make TRACE=1), otherwise TRACE_ZONE is nothing at all
+//TRACE_ZONE("name"); times from where it is to the end of its block, one per block
+
+#ifdef TETRIS_TRACE
+
+struct trace_zone {
+    const char *name;
+    uint64_t start;
+};
+
+//nanoseconds, for cpus without a timestamp counter
+uint64_t traceClock(void);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TRACE_TICKS() __builtin_ia32_rdtsc()
+#else
+#define TRACE_TICKS() traceClock()
+#endif
+
+#define TRACE_ZONE(name) struct trace_zone trace_zone __attribute__((cleanup(traceEnd))) = {name, TRACE_TICKS()}
+
+//makes room for capacity zones, any after that are dropped. zones ended before this are ignored
+bool traceStart(int capacity);
+void traceEnd(struct trace_zone *zone);
+//writes every zone so far to path and stops tracing
+bool traceFinish(const char *path);
+
+#else
+
+#define TRACE_ZONE(name)
+
+#endif
+
+#endif
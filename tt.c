@@ -0,0 +1,48 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tt.h"
+
+void initTable(struct table *table, int bits) {
+    table->entries = NULL;
+    table->mask = 0;
+    if (bits <= 0) {
+        return;
+    }
+    table->mask = ((uint64_t) 1 << bits) - 1;
+    table->entries = calloc(table->mask + 1, sizeof(struct tt_entry));
+}
+
+void freeTable(struct table *table) {
+    free(table->entries);
+    table->entries = NULL;
+}
+
+void clearTable(struct table *table) {
+    if (table->entries != NULL) {
+        memset(table->entries, 0, sizeof(struct tt_entry) * (table->mask + 1));
+    }
+}
+
+bool ttProbe(struct table *table, uint64_t key, uint64_t *data) {
+    if (table->entries == NULL) {
+        return false;
+    }
+    struct tt_entry *entry = &table->entries[key & table->mask];
+    uint64_t check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+    uint64_t stored = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+    //an empty slot would match a key of 0 with data 0, which is no use to anyone
+    if ((check ^ stored) != key || check == 0) {
+        return false;
+    }
+    *data = stored;
+    return true;
+}
+
+void ttStore(struct table *table, uint64_t key, uint64_t data) {
+    if (table->entries == NULL) {
+        return;
+    }
+    struct tt_entry *entry = &table->entries[key & table->mask];
+    __atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,30 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//a fixed size transposition table that threads share without locks. each entry keeps its key xored with its data
+//so an entry torn by two threads writing at once fails the check and reads as a miss instead of wrong data
+
+struct tt_entry {
+    uint64_t check;
+    uint64_t data;
+};
+
+struct table {
+    //NULL when the table is turned off, which makes every probe miss
+    struct tt_entry *entries;
+    uint64_t mask;
+};
+
+//makes a table of 2^bits entries, or a turned off one if bits is 0
+void initTable(struct table *table, int bits);
+void freeTable(struct table *table);
+void clearTable(struct table *table);
+//finds the data stored for key, returns false if it isn't there
+bool ttProbe(struct table *table, uint64_t key, uint64_t *data);
+//stores data for key, replacing whatever was in its slot
+void ttStore(struct table *table, uint64_t key, uint64_t data);
+
+#endif
@@ -0,0 +1,234 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "replay.h"
+#include "pool.h"
+
+//plays recorded games back through the game logic as fast as the cores allow and checks they end the way they were recorded
+
+enum outcomes {
+    VERIFIED,
+    MISMATCHED,
+    //cut short without a footer, so there's nothing to check against
+    UNFINISHED,
+    UNREADABLE
+};
+
+struct check {
+    char *path;
+    enum outcomes outcome;
+    long steps;
+    //seconds of play in the replay
+    double time;
+};
+
+struct verification {
+    struct check *checks;
+    int count;
+    //also seek into the replay from each keyframe and check it lands on the same game as playing there from the start
+    bool seeking;
+};
+
+double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+//whether two games are in the same position, leaving out the bytes between fields
+bool sameGame(const struct game_data *a, const struct game_data *b) {
+    return a->hash == b->hash && a->time == b->time && a->score == b->score && a->lines == b->lines && a->level == b->level
+           && a->pieces == b->pieces && a->drawn == b->drawn && a->current.type == b->current.type
+           && a->current.rotation == b->current.rotation && a->current.x == b->current.x && a->current.y == b->current.y
+           && a->over == b->over && memcmp(a->matrix.rows, b->matrix.rows, sizeof(a->matrix.rows)) == 0;
+}
+
+//seeks halfway past each keyframe with seekReplay, so the result comes from the keyframe plus the records after it
+//returns how many seeks there were, with the game and step each one ended at, or -1 if the replay couldn't be opened again
+//or there wasn't the memory, in which case seeks and steps are left NULL
+int seekKeyframes(const char *path, const struct replay *replay, struct game_data **seeks, uint64_t **steps) {
+    *seeks = NULL;
+    *steps = NULL;
+    int count = replay->keyframes != NULL ? replay->footer->keyframes : 0;
+    if (count == 0) {
+        return 0;
+    }
+    *seeks = malloc(sizeof(struct game_data) * count);
+    *steps = malloc(sizeof(uint64_t) * count);
+    int i;
+    for (i = 0; *seeks != NULL && *steps != NULL && i < count; i++) {
+        struct replay seeker;
+        if (!openReplay(&seeker, path, &(*seeks)[i])) {
+            break;
+        }
+        seekReplay(&seeker, &(*seeks)[i], replay->keyframes[i].state.time + REPLAY_KEYFRAME_INTERVAL / 2);
+        (*steps)[i] = seeker.step;
+        closeReplay(&seeker);
+    }
+    if (i < count) {
+        free(*seeks);
+        free(*steps);
+        *seeks = NULL;
+        *steps = NULL;
+        return -1;
+    }
+    return count;
+}
+
+void verifyReplay(void *context, int index, int worker) {
+    struct verification *verification = context;
+    struct check *check = &verification->checks[index];
+    struct replay replay;
+    struct game_data data;
+    if (!openReplay(&replay, check->path, &data)) {
+        check->outcome = UNREADABLE;
+        return;
+    }
+    struct game_data *seeks = NULL;
+    uint64_t *seek_steps = NULL;
+    int seek_count = verification->seeking ? seekKeyframes(check->path, &replay, &seeks, &seek_steps) : 0;
+    int seek = 0;
+    bool seeked = seek_count >= 0;
+    while (replayStep(&replay, &data)) {
+        //every seek has to match the game played from the start at the step it stopped on
+        while (seek < seek_count && seek_steps[seek] == replay.step) {
+            if (!sameGame(&seeks[seek], &data)) {
+                printf("%s: seeking from keyframe %d to step %llu gave a different game than playing from the start\n",
+                       check->path, seek, (unsigned long long) replay.step);
+                seeked = false;
+            }
+            seek = seek + 1;
+        }
+    }
+    free(seeks);
+    free(seek_steps);
+    check->steps = replay.step;
+    check->time = data.time;
+
+    const struct replay_footer *footer = replay.footer;
+    if (!seeked) {
+        check->outcome = MISMATCHED;
+    } else if (footer == NULL) {
+        check->outcome = UNFINISHED;
+    } else if (footer->steps != replay.step || footer->score != data.score || footer->lines != data.lines
+               || footer->level != data.level || footer->pieces != data.pieces || footer->topped_out != data.over) {
+        check->outcome = MISMATCHED;
+        printf("%s: recorded score %d lines %d level %d pieces %d steps %llu%s, played score %d lines %d level %d pieces %d steps %llu%s\n",
+               check->path, footer->score, footer->lines, footer->level, footer->pieces, (unsigned long long) footer->steps,
+               footer->topped_out ? " topped out" : "", data.score, data.lines, data.level, data.pieces,
+               (unsigned long long) replay.step, data.over ? " topped out" : "");
+    } else {
+        check->outcome = VERIFIED;
+    }
+    closeReplay(&replay);
+}
+
+//adds path to the checks, or every replay in it if it's a directory
+void addReplays(struct verification *verification, int *size, const char *path) {
+    struct stat info;
+    if (stat(path, &info) == 0 && S_ISDIR(info.st_mode)) {
+        DIR *directory = opendir(path);
+        if (directory == NULL) {
+            fprintf(stderr, "couldn't open %s\n", path);
+            return;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(directory)) != NULL) {
+            size_t length = strlen(entry->d_name);
+            if (length > 4 && strcmp(entry->d_name + length - 4, ".ttr") == 0) {
+                char *child = malloc(strlen(path) + length + 2);
+                sprintf(child, "%s/%s", path, entry->d_name);
+                addReplays(verification, size, child);
+                free(child);
+            }
+        }
+        closedir(directory);
+        return;
+    }
+    if (verification->count == *size) {
+        *size = *size * 2 + 64;
+        verification->checks = realloc(verification->checks, sizeof(struct check) * *size);
+    }
+    struct check *check = &verification->checks[verification->count];
+    check->path = strdup(path);
+    check->steps = 0;
+    check->time = 0;
+    verification->count = verification->count + 1;
+}
+
+void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-t threads] [-k] replay or directory...\n"
+                    "  -t threads     threads to check them on (all cores)\n"
+                    "  -k             also seek from every keyframe and check it matches playing from the start\n"
+                    "exits with 1 if any replay doesn't end the way it was recorded\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    int threads = poolCores();
+    bool seeking = false;
+    int option;
+    while ((option = getopt(argc, argv, "t:kh")) != -1) {
+        switch (option) {
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'k':
+                seeking = true;
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+    if (optind == argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    struct verification verification = {NULL, 0, seeking};
+    int size = 0;
+    int i;
+    for (i = optind; i < argc; i++) {
+        addReplays(&verification, &size, argv[i]);
+    }
+    if (verification.count == 0) {
+        fprintf(stderr, "no replays found\n");
+        return 1;
+    }
+
+    double start = now();
+    poolRun(threads, verification.count, verifyReplay, &verification);
+    double elapsed = now() - start;
+
+    int outcomes[4] = {0};
+    long steps = 0;
+    double played = 0;
+    for (i = 0; i < verification.count; i++) {
+        outcomes[verification.checks[i].outcome] = outcomes[verification.checks[i].outcome] + 1;
+        steps = steps + verification.checks[i].steps;
+        played = played + verification.checks[i].time;
+        if (verification.checks[i].outcome == UNREADABLE) {
+            printf("%s: not a replay this build can play\n", verification.checks[i].path);
+        }
+        free(verification.checks[i].path);
+    }
+    free(verification.checks);
+
+    printf("replays     %d on %d threads in %.3f s\n", verification.count, threads, elapsed);
+    printf("replays/sec %.1f\n", verification.count / elapsed);
+    printf("steps/sec   %.1f\n", steps / elapsed);
+    printf("speed       %.0fx real time\n", played / elapsed);
+    printf("verified    %d\n", outcomes[VERIFIED]);
+    printf("mismatched  %d\n", outcomes[MISMATCHED]);
+    printf("unfinished  %d\n", outcomes[UNFINISHED]);
+    printf("unreadable  %d\n", outcomes[UNREADABLE]);
+    return outcomes[MISMATCHED] > 0 || outcomes[UNREADABLE] > 0;
+}